@@ -5,16 +5,22 @@
 #define BUILD_DIR "./build/"
 #define PANIM_DIR "./panim/"
 #define PLUGS_DIR "./plugs/"
+#define BENCH_DIR BUILD_DIR"bench/"
+
+// Set for the builds of `./nob bench`
+static bool optimize = false;
 
 
 #ifdef _WIN32
 #define DYNLIB_EXT ".dll"
 #define OUT_FLAG "/Fe:"
 #define FFMPEG_SRC "ffmpeg_windows.c"
+#define EXE_EXT ".exe"
 
 void cflags(Nob_Cmd *cmd)
 {
     nob_cmd_append(cmd, "/W4", "/Z7", "/FC", "-D_CRT_SECURE_NO_WARNINGS=1","/diagnostics:caret", "/diagnostics:color");
+    if (optimize) nob_cmd_append(cmd, "/O2");
     nob_cmd_append(cmd, "-I./raylib/raylib-5.0_windows_amd64/include");
     nob_cmd_append(cmd, "-I"PANIM_DIR);
     nob_cmd_append(cmd, "-I.");
@@ -42,10 +48,12 @@ void libs(Nob_Cmd *cmd)
 #define DYNLIB_EXT ".do"
 #define OUT_FLAG "-o"
 #define FFMPEG_SRC "ffmpeg_linux.c"
+#define EXE_EXT ""
 
 void cflags(Nob_Cmd *cmd)
 {
     nob_cmd_append(cmd, "-Wall", "-Wextra", "-ggdb");
+    if (optimize) nob_cmd_append(cmd, "-O2");
     nob_cmd_append(cmd, "-I./raylib/raylib-5.0_linux_amd64/include");
     nob_cmd_append(cmd, "-I"PANIM_DIR);
     nob_cmd_append(cmd, "-I.");
@@ -89,7 +97,7 @@ bool build_plug_c3(bool force, Nob_Cmd *cmd, const char *output_path, const char
     return true;
 }
 
-bool build_plug_c(bool force, Nob_Cmd *cmd, const char *source_path, const char *output_path)
+bool build_plug_c(bool force, Nob_Cmd *cmd, const char *source_path, const char *output_path, bool saves_state)
 {
     int rebuild_is_needed = nob_needs_rebuild1(output_path, source_path);
     if (rebuild_is_needed < 0) return false;
@@ -113,6 +121,12 @@ bool build_plug_c(bool force, Nob_Cmd *cmd, const char *source_path, const char
         nob_cmd_append(cmd, "/EXPORT:plug_update");
         nob_cmd_append(cmd, "/EXPORT:plug_reset");
         nob_cmd_append(cmd, "/EXPORT:plug_finished");
+        if (saves_state) {
+            nob_cmd_append(cmd, "/EXPORT:plug_save");
+            nob_cmd_append(cmd, "/EXPORT:plug_load");
+        }
+#else
+        (void)saves_state;
 #endif
         return nob_cmd_run_sync_and_reset(cmd);
     }
@@ -121,7 +135,7 @@ bool build_plug_c(bool force, Nob_Cmd *cmd, const char *source_path, const char
     return true;
 }
 
-bool build_plug_cxx(bool force, Nob_Cmd *cmd, const char *source_path, const char *output_path)
+bool build_plug_cxx(bool force, Nob_Cmd *cmd, const char *source_path, const char *output_path, bool saves_state)
 {
     int rebuild_is_needed = nob_needs_rebuild1(output_path, source_path);
     if (rebuild_is_needed < 0) return false;
@@ -144,6 +158,12 @@ bool build_plug_cxx(bool force, Nob_Cmd *cmd, const char *source_path, const cha
         nob_cmd_append(cmd, "/EXPORT:plug_update");
         nob_cmd_append(cmd, "/EXPORT:plug_reset");
         nob_cmd_append(cmd, "/EXPORT:plug_finished");
+        if (saves_state) {
+            nob_cmd_append(cmd, "/EXPORT:plug_save");
+            nob_cmd_append(cmd, "/EXPORT:plug_load");
+        }
+#else
+        (void)saves_state;
 #endif
         return nob_cmd_run_sync_and_reset(cmd);
     }
@@ -169,6 +189,132 @@ bool build_exe(bool force, Nob_Cmd *cmd, const char **input_paths, size_t input_
     return true;
 }
 
+typedef struct {
+    const char *name;
+    const char *source_path;
+    bool cxx;
+    // Implements the optional plug_save() and plug_load()
+    bool saves_state;
+} Plug;
+
+static const Plug plugs[] = {
+    {.name = "tm",                .source_path = PLUGS_DIR"tm/plug.c", .saves_state = true},
+    {.name = "tasklesstm",        .source_path = PLUGS_DIR"tasklesstm/plug.c"},
+    {.name = "tasklesstsoding",   .source_path = PLUGS_DIR"tasklesstsoding/plug.c"},
+    {.name = "template",          .source_path = PLUGS_DIR"template/plug.c"},
+    {.name = "square",            .source_path = PLUGS_DIR"squares/plug.c", .saves_state = true},
+    {.name = "tasklesssquare",    .source_path = PLUGS_DIR"tasklesssquares/plug.c"},
+    {.name = "bezier",            .source_path = PLUGS_DIR"bezier/plug.c"},
+    {.name = "cpp",               .source_path = PLUGS_DIR"cpp/plug.cpp", .cxx = true},
+};
+
+static const char *plug_output_path(const char *build_dir, const Plug *plug)
+{
+    return nob_temp_sprintf("%slib%s"DYNLIB_EXT, build_dir, plug->name);
+}
+
+bool build_plug(bool force, Nob_Cmd *cmd, const char *build_dir, const Plug *plug)
+{
+    const char *output_path = plug_output_path(build_dir, plug);
+    if (plug->cxx) return build_plug_cxx(force, cmd, plug->source_path, output_path, plug->saves_state);
+    return build_plug_c(force, cmd, plug->source_path, output_path, plug->saves_state);
+}
+
+bool build_panim(bool force, Nob_Cmd *cmd, const char *output_path)
+{
+    const char *input_paths[] = {
+        PANIM_DIR"panim.c",
+        PANIM_DIR"readback.c",
+        PANIM_DIR"profile.c",
+        PANIM_DIR"yuv.c",
+        PANIM_DIR"framehash.c",
+        PANIM_DIR"trace.c",
+        PANIM_DIR"imageseq.c",
+        PANIM_DIR"mixer.c",
+        PANIM_DIR"soundconv.c",
+        PANIM_DIR"checkpoint.c",
+#ifndef _WIN32
+        PANIM_DIR"libav.c",
+#endif // _WIN32
+        PANIM_DIR FFMPEG_SRC
+    };
+    size_t input_paths_len = NOB_ARRAY_LEN(input_paths);
+    return build_exe(force, cmd, input_paths, input_paths_len, output_path);
+}
+
+// Builds optimized panim and plugins into BENCH_DIR, runs every plugin
+// headless for a fixed amount of frames and collects the results into
+// BUILD_DIR"bench.json" so they can be compared between commits.
+bool bench(bool force, Nob_Cmd *cmd, const char *profile, const char *frames)
+{
+    optimize = true;
+    if (!nob_mkdir_if_not_exists(BENCH_DIR)) return false;
+
+    const char *panim_path = BENCH_DIR"panim"EXE_EXT;
+    if (!build_panim(force, cmd, panim_path)) return false;
+#ifdef _WIN32
+    if (!nob_copy_file("./raylib/raylib-5.0_windows_amd64/lib/raylib.dll", BENCH_DIR"raylib.dll")) return false;
+#endif
+
+    bool result = true;
+    size_t count = 0;
+    Nob_String_Builder results = {0};
+    nob_sb_append_cstr(&results, "[\n");
+    for (size_t i = 0; i < NOB_ARRAY_LEN(plugs); ++i) {
+        const Plug *plug = &plugs[i];
+        if (!build_plug(force, cmd, BENCH_DIR, plug)) {
+            nob_log(NOB_ERROR, "could not build %s, skipping it", plug->name);
+            result = false;
+            continue;
+        }
+
+        const char *result_path = nob_temp_sprintf(BENCH_DIR"%s.json", plug->name);
+        nob_cmd_append(cmd, panim_path,
+                       "--profile", profile,
+                       "--bench", result_path,
+                       "--bench-frames", frames,
+                       plug_output_path(BENCH_DIR, plug));
+        if (!nob_cmd_run_sync_and_reset(cmd)) {
+            nob_log(NOB_ERROR, "benchmark of %s failed", plug->name);
+            result = false;
+            continue;
+        }
+
+        Nob_String_Builder sb = {0};
+        if (!nob_read_entire_file(result_path, &sb)) {
+            result = false;
+            continue;
+        }
+        if (count > 0) nob_sb_append_cstr(&results, ",\n");
+        Nob_String_View json = nob_sv_trim(nob_sb_to_sv(sb));
+        nob_sb_append_cstr(&results, "    ");
+        nob_sb_append_buf(&results, json.data, json.count);
+        count += 1;
+        nob_sb_free(sb);
+    }
+    nob_sb_append_cstr(&results, "\n]\n");
+
+    const char *output_path = BUILD_DIR"bench.json";
+    if (!nob_write_entire_file(output_path, results.items, results.count)) result = false;
+    else nob_log(NOB_INFO, "results of %zu benchmarks are in %s", count, output_path);
+    nob_sb_free(results);
+    return result;
+}
+
+// Builds and runs the tests of the task runtime of the tm plugin
+bool test(Nob_Cmd *cmd)
+{
+    const char *output_path = BUILD_DIR"tasks_test"EXE_EXT;
+    const char *input_paths[] = {PLUGS_DIR"tm/tasks_test.c"};
+    // Always rebuilt, because the tasks.c it includes is not among its inputs
+    if (!build_exe(true, cmd, input_paths, NOB_ARRAY_LEN(input_paths), output_path)) return false;
+#ifdef _WIN32
+    if (!nob_copy_file("./raylib/raylib-5.0_windows_amd64/lib/raylib.dll", BUILD_DIR"raylib.dll")) return false;
+#endif
+    nob_cmd_append(cmd, output_path);
+    return nob_cmd_run_sync_and_reset(cmd);
+}
+
 int main(int argc, char **argv)
 {
     NOB_GO_REBUILD_URSELF(argc, argv);
@@ -177,10 +323,21 @@ int main(int argc, char **argv)
     (void) program_name;
 
     bool force = false;
+    bool run_bench = false;
+    bool run_test = false;
+    const char *bench_profile = "review";
+    const char *bench_frames = "600";
     while (argc > 0) {
         const char *flag = nob_shift_args(&argc, &argv);
         if (strcmp(flag, "-f") == 0) {
             force = true;
+        } else if (strcmp(flag, "bench") == 0) {
+            // ./nob bench [<profile> [<frames>]]
+            run_bench = true;
+            if (argc > 0) bench_profile = nob_shift_args(&argc, &argv);
+            if (argc > 0) bench_frames = nob_shift_args(&argc, &argv);
+        } else if (strcmp(flag, "test") == 0) {
+            run_test = true;
         } else {
             nob_log(NOB_ERROR, "Unknown flag %s", flag);
             return 1;
@@ -190,14 +347,12 @@ int main(int argc, char **argv)
     if (!nob_mkdir_if_not_exists(BUILD_DIR)) return 1;
 
     Nob_Cmd cmd = {0};
-    if (!build_plug_c(force, &cmd, PLUGS_DIR"tm/plug.c", BUILD_DIR"libtm"DYNLIB_EXT)) return 1;
-    if (!build_plug_c(force, &cmd, PLUGS_DIR"tasklesstm/plug.c", BUILD_DIR"libtasklesstm"DYNLIB_EXT)) return 1;
-    if (!build_plug_c(force, &cmd, PLUGS_DIR"tasklesstsoding/plug.c", BUILD_DIR"libtasklesstsoding"DYNLIB_EXT)) return 1;
-    if (!build_plug_c(force, &cmd, PLUGS_DIR"template/plug.c", BUILD_DIR"libtemplate"DYNLIB_EXT)) return 1;
-    if (!build_plug_c(force, &cmd, PLUGS_DIR"squares/plug.c", BUILD_DIR"libsquare"DYNLIB_EXT)) return 1;
-    if (!build_plug_c(force, &cmd, PLUGS_DIR"tasklesssquares/plug.c", BUILD_DIR"libtasklesssquare"DYNLIB_EXT)) return 1;
-    if (!build_plug_c(force, &cmd, PLUGS_DIR"bezier/plug.c", BUILD_DIR"libbezier"DYNLIB_EXT)) return 1;
-    if (!build_plug_cxx(force, &cmd, PLUGS_DIR"cpp/plug.cpp", BUILD_DIR"libcpp"DYNLIB_EXT)) return 1;
+    if (run_bench) return bench(force, &cmd, bench_profile, bench_frames) ? 0 : 1;
+    if (run_test) return test(&cmd) ? 0 : 1;
+
+    for (size_t i = 0; i < NOB_ARRAY_LEN(plugs); ++i) {
+        if (!build_plug(force, &cmd, BUILD_DIR, &plugs[i])) return 1;
+    }
     {
         const char *output_path = BUILD_DIR"libc3";
         const char *source_paths[] = {
@@ -211,17 +366,7 @@ int main(int argc, char **argv)
     }
 
     {
-#ifdef _WIN32
-        const char *output_path = BUILD_DIR"panim.exe";
-#else
-        const char *output_path = BUILD_DIR"panim";
-#endif
-        const char *input_paths[] = {
-            PANIM_DIR"panim.c",
-            PANIM_DIR FFMPEG_SRC
-        };
-        size_t input_paths_len = NOB_ARRAY_LEN(input_paths);
-        if (!build_exe(force, &cmd, input_paths, input_paths_len, output_path)) return 1;
+        if (!build_panim(force, &cmd, BUILD_DIR"panim"EXE_EXT)) return 1;
 #ifdef _WIN32
         if(!nob_copy_file("./raylib/raylib-5.0_windows_amd64/lib/raylib.dll", BUILD_DIR"raylib.dll"))return 1;
 #endif
@@ -0,0 +1,60 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include "nob.h"
+#include "checkpoint.h"
+
+typedef struct {
+    Checkpoint *items;
+    size_t count;
+    size_t capacity;
+} Checkpoints;
+
+static Checkpoints checkpoints = {0};
+static size_t bytes = 0;
+
+void checkpoints_clear(void)
+{
+    for (size_t i = 0; i < checkpoints.count; ++i) {
+        free(checkpoints.items[i].data);
+    }
+    checkpoints.count = 0;
+    bytes = 0;
+}
+
+void *checkpoints_push(size_t frame, size_t size)
+{
+    assert((checkpoints.count == 0 || checkpoints.items[checkpoints.count - 1].frame < frame) && "checkpoints must be pushed in order");
+    Checkpoint checkpoint = {
+        .frame = frame,
+        .data = malloc(size),
+        .size = size,
+    };
+    assert(checkpoint.data != NULL && "Buy MORE RAM lol!!");
+    nob_da_append(&checkpoints, checkpoint);
+    bytes += size;
+    return checkpoint.data;
+}
+
+const Checkpoint *checkpoints_find(size_t frame)
+{
+    // The first checkpoint after frame
+    size_t lo = 0;
+    size_t hi = checkpoints.count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo)/2;
+        if (checkpoints.items[mid].frame <= frame) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo > 0 ? &checkpoints.items[lo - 1] : NULL;
+}
+
+size_t checkpoints_count(void)
+{
+    return checkpoints.count;
+}
+
+size_t checkpoints_bytes(void)
+{
+    return bytes;
+}
@@ -0,0 +1,26 @@
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include <stddef.h>
+
+// States of the plugin saved by the preview along the animation. Jumping to
+// a frame restores the nearest one before it and only simulates the frames in
+// between, instead of everything from the beginning.
+
+typedef struct {
+    size_t frame;
+    void *data;
+    size_t size;
+} Checkpoint;
+
+void checkpoints_clear(void);
+// Returns size bytes to save the state at frame into. The frames have to come
+// in increasing order.
+void *checkpoints_push(size_t frame, size_t size);
+// The last checkpoint at or before frame, NULL if there is none
+const Checkpoint *checkpoints_find(size_t frame);
+size_t checkpoints_count(void);
+// How much memory the saved states take altogether
+size_t checkpoints_bytes(void);
+
+#endif // CHECKPOINT_H_
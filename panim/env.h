@@ -9,7 +9,24 @@ typedef struct {
     float screen_width;
     float screen_height;
     bool rendering;
-    void (*play_sound)(Sound sound, Wave wave);
+    // Only advance the state of the animation, do not draw anything.
+    // Used by the Engine to fast-forward through the animation.
+    bool simulating;
+    // offset is how far into the current frame the sound starts, as a
+    // fraction of delta_time in [0, 1). The render starts it at that exact
+    // sample instead of at the beginning of the frame.
+    void (*play_sound)(Sound sound, Wave wave, float offset);
 } Env;
 
+// The offset for play_sound() when a progress that went from t1 to t2 during
+// the current frame crossed threshold, assuming it moved linearly in between
+static inline float env_crossing_offset(float t1, float t2, float threshold)
+{
+    if (t2 <= t1) return 0.0f;
+    float offset = (threshold - t1)/(t2 - t1);
+    if (offset < 0.0f) return 0.0f;
+    if (offset >= 1.0f) return 0.0f;
+    return offset;
+}
+
 #endif // ENV_H_
@@ -4,12 +4,33 @@
 #include <stddef.h>
 #include <stdbool.h>
 
+#include "profile.h"
+
 typedef struct FFMPEG FFMPEG;
 
-FFMPEG *ffmpeg_start_rendering_video(const char *output_path, size_t width, size_t height, size_t fps);
-FFMPEG *ffmpeg_start_rendering_audio(const char *output_path);
+// By default ffmpeg runs as a child process fed through pipes. When enabled
+// and libavcodec and libavformat of a known version are installed the
+// encoding happens in our own process instead (see libav.h). Both produce the
+// same file. Segments and audio-only renders always go through the child
+// process.
+void ffmpeg_use_libav(bool enabled);
+
+// The resolution, framerate, codecs and sound format come from the profile.
+// With profile->yuv420p the frames are converted from RGBA on our side (SIMD,
+// sliced between threads) and ffmpeg gets yuv420p, which is ~37% of the
+// bytes. Without it ffmpeg gets RGBA and does the conversion itself.
+FFMPEG *ffmpeg_start_rendering_video(const char *output_path, const Render_Profile *profile);
+// Video and audio go through separate pipes into a single ffmpeg that muxes them
+FFMPEG *ffmpeg_start_rendering_video_with_audio(const char *output_path, const Render_Profile *profile);
+// Same as ffmpeg_start_rendering_video_with_audio() but keeps the sound uncompressed,
+// so the segments can be joined by ffmpeg_concat_segments() without re-encoding the video
+FFMPEG *ffmpeg_start_rendering_segment(const char *output_path, const Render_Profile *profile);
+FFMPEG *ffmpeg_start_rendering_audio(const char *output_path, const Render_Profile *profile);
 bool ffmpeg_send_frame_flipped(FFMPEG *ffmpeg, void *data, size_t width, size_t height);
+// Sends the same picture as the previous frame without copying or converting it again
+bool ffmpeg_repeat_frame(FFMPEG *ffmpeg);
 bool ffmpeg_send_sound_samples(FFMPEG *ffmpeg, void *data, size_t size);
 bool ffmpeg_end_rendering(FFMPEG *ffmpeg, bool cancel);
+bool ffmpeg_concat_segments(const char *output_path, const char **segment_paths, size_t segment_count, const Render_Profile *profile);
 
 #endif // FFMPEG_H_
@@ -1,162 +1,774 @@
+#define _GNU_SOURCE
 #include <assert.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <stdatomic.h>
 
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
 
 #include <raylib.h>
 
 #include "ffmpeg.h"
+#include "yuv.h"
+#include "libav.h"
 
 #define READ_END 0
 #define WRITE_END 1
 
+// A 1080p RGBA frame is ~8MB, so the default 64KB pipe makes us go back and
+// forth with ffmpeg hundreds of times per frame. 1MB is the default limit for
+// unprivileged processes (see /proc/sys/fs/pipe-max-size).
+#define FFMPEG_PIPE_CAPACITY (1024*1024)
+
+// Where ffmpeg finds the audio pipe when it also gets video on stdin
+#define FFMPEG_AUDIO_CHILD_FD 3
+#define FFMPEG_AUDIO_CHILD_FD_STR "3"
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+typedef struct {
+    int fd;
+
+    // Statistics
+    size_t bytes;
+    double busy_secs;
+} Pipe;
+
+// How many video frames may wait for the writer thread before
+// ffmpeg_send_frame_flipped() starts blocking the render loop
+#define FFMPEG_QUEUE_CAPACITY 8
+
+// How many threads convert a frame to yuv420p, the writer thread included
+#define FFMPEG_YUV_THREADS 4
+
+typedef struct {
+    void *data;
+    size_t width;
+    size_t height;
+    // Send the previous frame again instead, data is not used
+    bool repeat;
+} Frame;
+
+typedef struct {
+    const Frame *frame;
+    uint8_t *yuv;
+    size_t row_begin;
+    size_t row_end;
+} Yuv_Slice;
+
+// Converts one slice of every frame for the writer thread. It is started once
+// along with the writer and waits on go for its next slice, a slice without a
+// frame tells it to quit.
+typedef struct {
+    pthread_t thread;
+    sem_t go;
+    sem_t *done;
+    Yuv_Slice slice;
+} Yuv_Helper;
+
+// Video frames are pushed by the render loop and drained into the pipe by a
+// dedicated writer thread, so rendering the next frame overlaps with ffmpeg
+// consuming the previous ones. The ring is single-producer/single-consumer:
+// head is only advanced by the render loop and tail only by the writer. The
+// semaphores are there just to sleep instead of spinning when the ring is
+// full or empty.
+//
+// Every frame is copied once, into its slot of the ring. The pixels the render
+// loop pushes belong to the readback, which unmaps or reuses them right after,
+// while the writer may still be sending an older frame. From the slot on the
+// frame goes into the pipe with no more copies.
+typedef struct {
+    Pipe *pipe;
+    // When set the converted frames go into the in-process encoder instead of the pipe
+    Libav *libav;
+    Frame frames[FFMPEG_QUEUE_CAPACITY];
+    atomic_size_t head;
+    atomic_size_t tail;
+    sem_t filled;
+    sem_t free;
+    atomic_bool failed;
+    atomic_bool closing;
+    pthread_t thread;
+
+    // The previous frame, kept for the repeats. Only the writer thread touches it.
+    Frame last;
+
+    // When set the frames are converted to yuv420p before they hit the pipe
+    bool yuv420p;
+    uint8_t *yuv;
+    size_t yuv_size;
+    size_t yuv_threads;
+    Yuv_Helper yuv_helpers[FFMPEG_YUV_THREADS - 1];
+    size_t yuv_helpers_count;
+    sem_t yuv_done;
+
+    // Statistics
+    size_t pushed;
+    size_t repeated;
+    size_t depth_sum;
+    size_t depth_max;
+    size_t stalls;
+    double backpressure_secs;
+    double convert_secs;
+} Queue;
+
 struct FFMPEG {
-    int pipe;
+    Pipe video;
+    Pipe audio;
     pid_t pid;
+    Queue *queue;
+    // Set when encoding in-process, there are no pipes nor pid then
+    Libav *libav;
+    double started_at;
 };
 
-FFMPEG *ffmpeg_start_rendering_video(const char *output_path, size_t width, size_t height, size_t fps)
+static bool use_libav = false;
+
+static double now_secs(void)
 {
-    int pipefd[2];
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
 
-    if (pipe(pipefd) < 0) {
-        TraceLog(LOG_ERROR, "FFMPEG: Could not create a pipe: %s", strerror(errno));
-        return NULL;
+static void raise_pipe_capacity(int fd)
+{
+    if (fcntl(fd, F_SETPIPE_SZ, FFMPEG_PIPE_CAPACITY) < 0) {
+        TraceLog(LOG_WARNING, "FFMPEG: could not raise the pipe capacity to %d bytes: %s", FFMPEG_PIPE_CAPACITY, strerror(errno));
     }
+}
 
-    pid_t child = fork();
-    if (child < 0) {
-        TraceLog(LOG_ERROR, "FFMPEG: could not fork a child: %s", strerror(errno));
-        return NULL;
+// Writes all of iov, picking up where the previous call left off whenever the
+// kernel accepts only a part of it. iov is consumed in the process.
+static bool pipe_writev(Pipe *pipe, struct iovec *iov, int iovcnt)
+{
+    double start = now_secs();
+    while (iovcnt > 0) {
+        ssize_t n = writev(pipe->fd, iov, iovcnt);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            pipe->busy_secs += now_secs() - start;
+            return false;
+        }
+        pipe->bytes += n;
+
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov += 1;
+            iovcnt -= 1;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (uint8_t*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
     }
+    pipe->busy_secs += now_secs() - start;
+    return true;
+}
 
-    if (child == 0) {
-        if (dup2(pipefd[READ_END], STDIN_FILENO) < 0) {
-            TraceLog(LOG_ERROR, "FFMPEG CHILD: could not reopen read end of pipe as stdin: %s", strerror(errno));
-            exit(1);
+// The rows are handed to the kernel bottom to top, so flipping the frame takes
+// no copy of its own. That's at most IOV_MAX rows per syscall instead of one.
+static bool write_frame_flipped(Pipe *pipe, void *data, size_t width, size_t height)
+{
+    struct iovec iov[IOV_MAX];
+    size_t stride = sizeof(uint32_t)*width;
+    size_t y = height;
+    while (y > 0) {
+        int iovcnt = 0;
+        while (y > 0 && iovcnt < IOV_MAX) {
+            y -= 1;
+            iov[iovcnt].iov_base = (uint8_t*)data + y*stride;
+            iov[iovcnt].iov_len = stride;
+            iovcnt += 1;
+        }
+        if (!pipe_writev(pipe, iov, iovcnt)) {
+            TraceLog(LOG_ERROR, "FFMPEG: failed to write frame into ffmpeg pipe: %s", strerror(errno));
+            return false;
         }
-        close(pipefd[WRITE_END]);
+    }
+    return true;
+}
 
-        char resolution[64];
-        snprintf(resolution, sizeof(resolution), "%zux%zu", width, height);
-        char framerate[64];
-        snprintf(framerate, sizeof(framerate), "%zu", fps);
+static void convert_slice(const Yuv_Slice *slice)
+{
+    rgba_to_yuv420p_flipped(slice->frame->data, slice->frame->width, slice->frame->height,
+                            slice->row_begin, slice->row_end, slice->yuv);
+}
 
-        int ret = execlp("ffmpeg",
-            "ffmpeg",
+static void *yuv_helper(void *arg)
+{
+    Yuv_Helper *helper = arg;
+    for (;;) {
+        while (sem_wait(&helper->go) < 0 && errno == EINTR);
+        if (helper->slice.frame == NULL) break;
+        convert_slice(&helper->slice);
+        sem_post(helper->done);
+    }
+    return NULL;
+}
 
-            "-loglevel", "verbose",
-            "-y",
+// The writer thread counts as one of the yuv_threads, so up to
+// FFMPEG_YUV_THREADS - 1 helpers are started. If some of them can't be
+// started the frames are just split between fewer threads.
+static void yuv_helpers_start(Queue *q, size_t threads)
+{
+    sem_init(&q->yuv_done, 0, 0);
+    q->yuv_helpers_count = 0;
+    while (q->yuv_helpers_count + 1 < threads) {
+        Yuv_Helper *helper = &q->yuv_helpers[q->yuv_helpers_count];
+        helper->done = &q->yuv_done;
+        helper->slice = (Yuv_Slice) {0};
+        sem_init(&helper->go, 0, 0);
+        int err = pthread_create(&helper->thread, NULL, yuv_helper, helper);
+        if (err != 0) {
+            TraceLog(LOG_WARNING, "FFMPEG: could not start a yuv420p conversion thread: %s", strerror(err));
+            sem_destroy(&helper->go);
+            break;
+        }
+        q->yuv_helpers_count += 1;
+    }
+    q->yuv_threads = q->yuv_helpers_count + 1;
+}
 
-            "-f", "rawvideo",
-            "-pix_fmt", "rgba",
-            "-s", resolution,
-            "-r", framerate,
-            "-i", "-",
+static void yuv_helpers_stop(Queue *q)
+{
+    for (size_t i = 0; i < q->yuv_helpers_count; ++i) {
+        Yuv_Helper *helper = &q->yuv_helpers[i];
+        helper->slice = (Yuv_Slice) {0};
+        sem_post(&helper->go);
+        pthread_join(helper->thread, NULL);
+        sem_destroy(&helper->go);
+    }
+    q->yuv_helpers_count = 0;
+    sem_destroy(&q->yuv_done);
+}
 
-            "-c:v", "libx264",
-            "-vb", "2500k",
-            "-c:a", "aac",
-            "-ab", "200k",
-            "-pix_fmt", "yuv420p",
-            output_path,
+static bool write_yuv420p(Queue *q)
+{
+    if (q->libav) return libav_send_video(q->libav, q->yuv);
 
-            NULL
-        );
-        if (ret < 0) {
-            TraceLog(LOG_ERROR, "FFMPEG CHILD: could not run ffmpeg as a child process: %s", strerror(errno));
-            exit(1);
+    struct iovec iov = { .iov_base = q->yuv, .iov_len = q->yuv_size };
+    if (!pipe_writev(q->pipe, &iov, 1)) {
+        TraceLog(LOG_ERROR, "FFMPEG: failed to write frame into ffmpeg pipe: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+// Converts the frame to yuv420p and sends it as a single write, which is
+// ~37% of the bytes of the RGBA frame. The rows are split between
+// yuv_threads threads, each one taking an even amount of them so no chroma
+// row is shared.
+static bool write_frame_yuv420p(Queue *q, const Frame *frame)
+{
+    size_t size = yuv420p_size(frame->width, frame->height);
+    if (q->yuv_size != size) {
+        free(q->yuv);
+        q->yuv = malloc(size);
+        assert(q->yuv != NULL && "Buy MORE RAM lol!!");
+        q->yuv_size = size;
+    }
+
+    double start = now_secs();
+    Yuv_Slice slices[FFMPEG_YUV_THREADS];
+    size_t rows = ((frame->height + q->yuv_threads - 1)/q->yuv_threads + 1)&~(size_t)1;
+    if (rows < 2) rows = 2;
+    size_t count = 0;
+    for (size_t row = 0; row < frame->height; row += rows) {
+        assert(count < FFMPEG_YUV_THREADS);
+        slices[count] = (Yuv_Slice) {
+            .frame = frame,
+            .yuv = q->yuv,
+            .row_begin = row,
+            .row_end = row + rows,
+        };
+        count += 1;
+    }
+    // The writer thread does the first slice itself while the helpers do the rest
+    assert(count <= q->yuv_helpers_count + 1);
+    for (size_t i = 1; i < count; ++i) {
+        q->yuv_helpers[i - 1].slice = slices[i];
+        sem_post(&q->yuv_helpers[i - 1].go);
+    }
+    if (count > 0) convert_slice(&slices[0]);
+    for (size_t i = 1; i < count; ++i) {
+        while (sem_wait(&q->yuv_done) < 0 && errno == EINTR);
+    }
+    q->convert_secs += now_secs() - start;
+
+    return write_yuv420p(q);
+}
+
+static bool queue_write_frame(Queue *q, Frame *frame)
+{
+    if (frame->repeat) {
+        // The in-process encoder skips the frame and only moves the timestamps on
+        if (q->libav) return libav_repeat_video(q->libav);
+
+        // Raw video through the pipe has no timestamps, so the ffmpeg CLI still
+        // gets and encodes the whole frame. Only the conversion is saved, the
+        // bytes are at hand: converted in yuv, or as they came in last.
+        assert(q->last.data != NULL);
+        if (q->yuv420p) return write_yuv420p(q);
+        return write_frame_flipped(q->pipe, q->last.data, q->last.width, q->last.height);
+    }
+
+    bool ok = q->yuv420p ? write_frame_yuv420p(q, frame)
+                         : write_frame_flipped(q->pipe, frame->data, frame->width, frame->height);
+
+    // Keep the frame around for the repeats and give the slot the buffer of the previous one
+    Frame last = q->last;
+    q->last = *frame;
+    *frame = last;
+    return ok;
+}
+
+static void *queue_writer(void *arg)
+{
+    Queue *q = arg;
+
+    for (;;) {
+        sem_wait(&q->filled);
+        size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+        if (tail == head) {
+            // Woken up with nothing in the ring means we are closing
+            assert(atomic_load(&q->closing));
+            break;
         }
-        assert(0 && "unreachable");
-        exit(1);
+
+        Frame *frame = &q->frames[tail%FFMPEG_QUEUE_CAPACITY];
+        // After the first failure keep draining the frames so the render loop never blocks forever
+        if (!atomic_load(&q->failed) && !queue_write_frame(q, frame)) {
+            atomic_store(&q->failed, true);
+        }
+
+        atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+        sem_post(&q->free);
     }
 
-    if (close(pipefd[READ_END]) < 0) {
-        TraceLog(LOG_WARNING, "FFMPEG: could not close read end of the pipe on the parent's end: %s", strerror(errno));
+    return NULL;
+}
+
+static bool queue_start(FFMPEG *ffmpeg, bool yuv420p)
+{
+    Queue *q = malloc(sizeof(Queue));
+    assert(q != NULL && "Buy MORE RAM lol!!");
+    memset(q, 0, sizeof(*q));
+    q->pipe = &ffmpeg->video;
+    q->libav = ffmpeg->libav;
+    q->yuv420p = yuv420p;
+    if (yuv420p) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        yuv_helpers_start(q, cpus < 1 ? 1 : cpus < FFMPEG_YUV_THREADS ? (size_t)cpus : FFMPEG_YUV_THREADS);
+    }
+    sem_init(&q->filled, 0, 0);
+    sem_init(&q->free, 0, FFMPEG_QUEUE_CAPACITY);
+    ffmpeg->queue = q;
+
+    int err = pthread_create(&q->thread, NULL, queue_writer, q);
+    if (err != 0) {
+        TraceLog(LOG_ERROR, "FFMPEG: could not start the writer thread: %s", strerror(err));
+        if (yuv420p) yuv_helpers_stop(q);
+        sem_destroy(&q->filled);
+        sem_destroy(&q->free);
+        free(q);
+        ffmpeg->queue = NULL;
+        return false;
     }
+    return true;
+}
 
-    FFMPEG *ffmpeg = malloc(sizeof(FFMPEG));
-    assert(ffmpeg != NULL && "Buy MORE RAM lol!!");
-    ffmpeg->pid = child;
-    ffmpeg->pipe = pipefd[WRITE_END];
-    return ffmpeg;
+// Waits for a free slot in the ring
+static Frame *queue_reserve(Queue *q)
+{
+    if (sem_trywait(&q->free) < 0) {
+        q->stalls += 1;
+        double start = now_secs();
+        while (sem_wait(&q->free) < 0 && errno == EINTR);
+        q->backpressure_secs += now_secs() - start;
+    }
+
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    return &q->frames[head%FFMPEG_QUEUE_CAPACITY];
+}
+
+// Hands the reserved slot over to the writer thread
+static void queue_commit(Queue *q)
+{
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    size_t depth = head - tail + 1;
+    q->pushed += 1;
+    q->depth_sum += depth;
+    if (depth > q->depth_max) q->depth_max = depth;
+
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    sem_post(&q->filled);
+}
+
+static bool queue_push(Queue *q, void *data, size_t width, size_t height)
+{
+    if (atomic_load(&q->failed)) return false;
+
+    Frame *frame = queue_reserve(q);
+    if (frame->data == NULL || frame->width != width || frame->height != height) {
+        free(frame->data);
+        frame->data = NULL;
+        int err = posix_memalign(&frame->data, sysconf(_SC_PAGESIZE), sizeof(uint32_t)*width*height);
+        assert(err == 0 && "Buy MORE RAM lol!!");
+        frame->width = width;
+        frame->height = height;
+    }
+    // The one copy the frame gets on its way to ffmpeg
+    memcpy(frame->data, data, sizeof(uint32_t)*width*height);
+    frame->repeat = false;
+
+    queue_commit(q);
+    return true;
 }
 
-FFMPEG *ffmpeg_start_rendering_audio(const char *output_path)
+static bool queue_push_repeat(Queue *q)
 {
-    int pipefd[2];
+    if (atomic_load(&q->failed)) return false;
+
+    Frame *frame = queue_reserve(q);
+    frame->repeat = true;
+    q->repeated += 1;
+
+    queue_commit(q);
+    return true;
+}
+
+// Returns false if any of the queued frames failed to reach ffmpeg
+static bool queue_finish(Queue *q)
+{
+    atomic_store(&q->closing, true);
+    sem_post(&q->filled);
+    pthread_join(q->thread, NULL);
+    if (q->yuv420p) yuv_helpers_stop(q);
+
+    if (q->pushed > 0) {
+        TraceLog(LOG_INFO, "FFMPEG: writer queue: %zu frames, average depth %.2f, max depth %zu/%d",
+                 q->pushed, (double)q->depth_sum/q->pushed, q->depth_max, FFMPEG_QUEUE_CAPACITY);
+        TraceLog(LOG_INFO, "FFMPEG: writer queue: %zu stalls, %.3fs spent waiting on ffmpeg",
+                 q->stalls, q->backpressure_secs);
+        TraceLog(LOG_INFO, "FFMPEG: writer queue: %zu frames (%.1f%%) were repeats of the previous one",
+                 q->repeated, q->repeated*100.0/q->pushed);
+        if (q->yuv420p) {
+            TraceLog(LOG_INFO, "FFMPEG: writer queue: %.3fs converting to yuv420p on %zu threads (%.2fms per frame)",
+                     q->convert_secs, q->yuv_threads, q->convert_secs*1000.0/(q->pushed - q->repeated));
+        }
+    }
+
+    bool ok = !atomic_load(&q->failed);
+    for (size_t i = 0; i < FFMPEG_QUEUE_CAPACITY; ++i) {
+        free(q->frames[i].data);
+    }
+    free(q->last.data);
+    free(q->yuv);
+    sem_destroy(&q->filled);
+    sem_destroy(&q->free);
+    free(q);
+    return ok;
+}
 
+static bool open_pipe(int pipefd[2])
+{
     if (pipe(pipefd) < 0) {
         TraceLog(LOG_ERROR, "FFMPEG: Could not create a pipe: %s", strerror(errno));
+        return false;
+    }
+    raise_pipe_capacity(pipefd[WRITE_END]);
+    return true;
+}
+
+static void close_pipe(int pipefd[2])
+{
+    if (pipefd[READ_END] >= 0) close(pipefd[READ_END]);
+    if (pipefd[WRITE_END] >= 0) close(pipefd[WRITE_END]);
+}
+
+// Runs ffmpeg with args and connects the requested pipes to it. The video
+// pipe becomes ffmpeg's stdin. The audio pipe becomes stdin too if there is
+// no video, otherwise it is passed as fd FFMPEG_AUDIO_CHILD_FD (pipe:3).
+// With yuv420p the video frames are converted on our side before sending.
+static FFMPEG *ffmpeg_spawn(const char **args, bool video, bool audio, bool yuv420p)
+{
+    int video_pipe[2] = {-1, -1};
+    int audio_pipe[2] = {-1, -1};
+
+    if (video && !open_pipe(video_pipe)) return NULL;
+    if (audio && !open_pipe(audio_pipe)) {
+        close_pipe(video_pipe);
         return NULL;
     }
 
     pid_t child = fork();
     if (child < 0) {
         TraceLog(LOG_ERROR, "FFMPEG: could not fork a child: %s", strerror(errno));
+        close_pipe(video_pipe);
+        close_pipe(audio_pipe);
         return NULL;
     }
 
     if (child == 0) {
-        if (dup2(pipefd[READ_END], STDIN_FILENO) < 0) {
+        if (video) close(video_pipe[WRITE_END]);
+        if (audio) close(audio_pipe[WRITE_END]);
+
+        if (video && dup2(video_pipe[READ_END], STDIN_FILENO) < 0) {
             TraceLog(LOG_ERROR, "FFMPEG CHILD: could not reopen read end of pipe as stdin: %s", strerror(errno));
             exit(1);
         }
-        close(pipefd[WRITE_END]);
-
-        int ret = execlp("ffmpeg",
-            "ffmpeg",
-
-            "-loglevel", "verbose",
-            "-y",
-
-            "-f", "s16le",
-            "-sample_rate", "44100",
-            "-channels", "2",
-            "-i", "-",
-
-            "-c:a", "pcm_s16le",
-            output_path,
-
-            NULL
-        );
-        if (ret < 0) {
-            TraceLog(LOG_ERROR, "FFMPEG CHILD: could not run ffmpeg as a child process: %s", strerror(errno));
+        if (audio && dup2(audio_pipe[READ_END], video ? FFMPEG_AUDIO_CHILD_FD : STDIN_FILENO) < 0) {
+            TraceLog(LOG_ERROR, "FFMPEG CHILD: could not reopen read end of audio pipe: %s", strerror(errno));
             exit(1);
         }
-        assert(0 && "unreachable");
+
+        execvp("ffmpeg", (char * const*)args);
+        TraceLog(LOG_ERROR, "FFMPEG CHILD: could not run ffmpeg as a child process: %s", strerror(errno));
         exit(1);
     }
 
-    if (close(pipefd[READ_END]) < 0) {
+    if ((video && close(video_pipe[READ_END]) < 0) || (audio && close(audio_pipe[READ_END]) < 0)) {
         TraceLog(LOG_WARNING, "FFMPEG: could not close read end of the pipe on the parent's end: %s", strerror(errno));
     }
 
+    // A dead ffmpeg should surface as a failed write(), not kill us
+    signal(SIGPIPE, SIG_IGN);
+
     FFMPEG *ffmpeg = malloc(sizeof(FFMPEG));
     assert(ffmpeg != NULL && "Buy MORE RAM lol!!");
+    memset(ffmpeg, 0, sizeof(*ffmpeg));
     ffmpeg->pid = child;
-    ffmpeg->pipe = pipefd[WRITE_END];
+    ffmpeg->video.fd = video_pipe[WRITE_END];
+    ffmpeg->audio.fd = audio_pipe[WRITE_END];
+    ffmpeg->started_at = now_secs();
+    if (video && !queue_start(ffmpeg, yuv420p)) {
+        ffmpeg_end_rendering(ffmpeg, true);
+        return NULL;
+    }
+    return ffmpeg;
+}
+
+// Encodes into output_path with libavcodec in our own process. Returns NULL
+// when that is not possible, and the caller spawns the ffmpeg CLI instead.
+static FFMPEG *libav_spawn(const char *output_path, const Render_Profile *profile, bool audio)
+{
+    if (!use_libav) return NULL;
+    Libav *libav = libav_start(output_path, profile, audio);
+    if (libav == NULL) return NULL;
+
+    FFMPEG *ffmpeg = malloc(sizeof(FFMPEG));
+    assert(ffmpeg != NULL && "Buy MORE RAM lol!!");
+    memset(ffmpeg, 0, sizeof(*ffmpeg));
+    ffmpeg->pid = -1;
+    ffmpeg->video.fd = -1;
+    ffmpeg->audio.fd = -1;
+    ffmpeg->libav = libav;
+    ffmpeg->started_at = now_secs();
+    // The encoder only takes yuv420p, so the frames are always converted on our side
+    if (!queue_start(ffmpeg, true)) {
+        libav_end(libav, true);
+        free(ffmpeg);
+        return NULL;
+    }
     return ffmpeg;
 }
 
+typedef struct {
+    const char *items[64];
+    size_t count;
+} Args;
+
+static void args_append(Args *args, const char *arg)
+{
+    assert(args->count < sizeof(args->items)/sizeof(args->items[0]));
+    args->items[args->count++] = arg;
+}
+
+typedef struct {
+    char resolution[64];
+    char framerate[32];
+    char crf[32];
+    char sample_rate[32];
+    char channels[32];
+} Arg_Buffers;
+
+static void append_video_input(Args *args, Arg_Buffers *buffers, const Render_Profile *profile)
+{
+    snprintf(buffers->resolution, sizeof(buffers->resolution), "%zux%zu", profile->width, profile->height);
+    snprintf(buffers->framerate, sizeof(buffers->framerate), "%zu", profile->fps);
+
+    args_append(args, "-f");       args_append(args, "rawvideo");
+    args_append(args, "-pix_fmt"); args_append(args, profile->yuv420p ? "yuv420p" : "rgba");
+    args_append(args, "-s");       args_append(args, buffers->resolution);
+    args_append(args, "-r");       args_append(args, buffers->framerate);
+    args_append(args, "-i");       args_append(args, "-");
+}
+
+static void append_audio_input(Args *args, Arg_Buffers *buffers, const Render_Profile *profile, const char *input)
+{
+    snprintf(buffers->sample_rate, sizeof(buffers->sample_rate), "%zu", profile->sample_rate);
+    snprintf(buffers->channels, sizeof(buffers->channels), "%zu", profile->channels);
+
+    args_append(args, "-f");           args_append(args, "s16le");
+    args_append(args, "-sample_rate"); args_append(args, buffers->sample_rate);
+    args_append(args, "-channels");    args_append(args, buffers->channels);
+    args_append(args, "-i");           args_append(args, input);
+}
+
+static void append_video_output(Args *args, Arg_Buffers *buffers, const Render_Profile *profile)
+{
+    args_append(args, "-c:v"); args_append(args, profile->video_codec);
+    if (profile->preset[0] != '\0') {
+        args_append(args, "-preset"); args_append(args, profile->preset);
+    }
+    if (profile->video_bitrate[0] != '\0') {
+        args_append(args, "-vb"); args_append(args, profile->video_bitrate);
+    } else {
+        snprintf(buffers->crf, sizeof(buffers->crf), "%d", profile->crf);
+        args_append(args, "-crf"); args_append(args, buffers->crf);
+    }
+    args_append(args, "-pix_fmt"); args_append(args, "yuv420p");
+}
+
+static void append_audio_output(Args *args, const char *audio_codec, const char *audio_bitrate)
+{
+    args_append(args, "-c:a"); args_append(args, audio_codec);
+    if (audio_bitrate) {
+        args_append(args, "-ab"); args_append(args, audio_bitrate);
+    }
+}
+
+static void append_header(Args *args)
+{
+    args_append(args, "ffmpeg");
+    args_append(args, "-loglevel"); args_append(args, "verbose");
+    args_append(args, "-y");
+}
+
+void ffmpeg_use_libav(bool enabled)
+{
+    use_libav = enabled;
+}
+
+FFMPEG *ffmpeg_start_rendering_video(const char *output_path, const Render_Profile *profile)
+{
+    FFMPEG *ffmpeg = libav_spawn(output_path, profile, false);
+    if (ffmpeg) return ffmpeg;
+
+    Args args = {0};
+    Arg_Buffers buffers = {0};
+    append_header(&args);
+    append_video_input(&args, &buffers, profile);
+    append_video_output(&args, &buffers, profile);
+    args_append(&args, output_path);
+    args_append(&args, NULL);
+    return ffmpeg_spawn(args.items, true, false, profile->yuv420p);
+}
+
+static FFMPEG *start_rendering_video_with_audio(const char *output_path, const Render_Profile *profile, bool segment)
+{
+    // Segments stay with the CLI, their uncompressed sound is s16 rather than the fltp libav takes
+    if (!segment) {
+        FFMPEG *ffmpeg = libav_spawn(output_path, profile, true);
+        if (ffmpeg) return ffmpeg;
+    }
+
+    Args args = {0};
+    Arg_Buffers buffers = {0};
+    append_header(&args);
+    append_video_input(&args, &buffers, profile);
+    append_audio_input(&args, &buffers, profile, "pipe:" FFMPEG_AUDIO_CHILD_FD_STR);
+    append_video_output(&args, &buffers, profile);
+    if (segment) {
+        append_audio_output(&args, "pcm_s16le", NULL);
+    } else {
+        append_audio_output(&args, profile->audio_codec, profile->audio_bitrate);
+    }
+    args_append(&args, output_path);
+    args_append(&args, NULL);
+    return ffmpeg_spawn(args.items, true, true, profile->yuv420p);
+}
+
+FFMPEG *ffmpeg_start_rendering_video_with_audio(const char *output_path, const Render_Profile *profile)
+{
+    return start_rendering_video_with_audio(output_path, profile, false);
+}
+
+FFMPEG *ffmpeg_start_rendering_segment(const char *output_path, const Render_Profile *profile)
+{
+    return start_rendering_video_with_audio(output_path, profile, true);
+}
+
+FFMPEG *ffmpeg_start_rendering_audio(const char *output_path, const Render_Profile *profile)
+{
+    Args args = {0};
+    Arg_Buffers buffers = {0};
+    append_header(&args);
+    append_audio_input(&args, &buffers, profile, "-");
+    append_audio_output(&args, "pcm_s16le", NULL);
+    args_append(&args, output_path);
+    args_append(&args, NULL);
+    return ffmpeg_spawn(args.items, false, true, false);
+}
+
+static bool libav_end_rendering(FFMPEG *ffmpeg, bool cancel)
+{
+    // Canceling makes the writer thread drop the queued frames instead of encoding them
+    if (cancel) atomic_store(&ffmpeg->queue->failed, true);
+    bool ok = queue_finish(ffmpeg->queue);
+    if (!libav_end(ffmpeg->libav, cancel || !ok)) ok = false;
+
+    double elapsed = now_secs() - ffmpeg->started_at;
+    TraceLog(LOG_INFO, "FFMPEG: encoded in-process in %.2fs", elapsed);
+    free(ffmpeg);
+    return ok && !cancel;
+}
+
 bool ffmpeg_end_rendering(FFMPEG *ffmpeg, bool cancel)
 {
-    int pipe = ffmpeg->pipe;
+    if (ffmpeg->libav) return libav_end_rendering(ffmpeg, cancel);
+
     pid_t pid = ffmpeg->pid;
 
-    free(ffmpeg);
+    // Killing ffmpeg first makes the writer thread fail fast instead of flushing the queue
+    if (cancel) kill(pid, SIGKILL);
+
+    bool queue_ok = true;
+    if (ffmpeg->queue) queue_ok = queue_finish(ffmpeg->queue);
+
+    Pipe *pipes[] = {&ffmpeg->video, &ffmpeg->audio};
+    double elapsed = now_secs() - ffmpeg->started_at;
+    for (size_t i = 0; i < sizeof(pipes)/sizeof(pipes[0]); ++i) {
+        if (pipes[i]->fd < 0) continue;
 
-    if (close(pipe) < 0) {
-        TraceLog(LOG_WARNING, "FFMPEG: could not close write end of the pipe on the parent's end: %s", strerror(errno));
+        if (close(pipes[i]->fd) < 0) {
+            TraceLog(LOG_WARNING, "FFMPEG: could not close write end of the pipe on the parent's end: %s", strerror(errno));
+        }
+
+        double mbytes = pipes[i]->bytes/(1024.0*1024.0);
+        TraceLog(LOG_INFO, "FFMPEG: sent %.2f MB of %s in %.2fs (%.2f MB/s), %.2fs of it blocked in write()",
+                 mbytes, pipes[i] == &ffmpeg->video ? "video" : "audio",
+                 elapsed, elapsed > 0 ? mbytes/elapsed : 0.0, pipes[i]->busy_secs);
     }
 
-    if (cancel) kill(pid, SIGKILL);
+    free(ffmpeg);
 
     for (;;) {
         int wstatus = 0;
@@ -172,7 +784,7 @@ bool ffmpeg_end_rendering(FFMPEG *ffmpeg, bool cancel)
                 return false;
             }
 
-            return true;
+            return queue_ok;
         }
 
         if (WIFSIGNALED(wstatus)) {
@@ -186,21 +798,70 @@ bool ffmpeg_end_rendering(FFMPEG *ffmpeg, bool cancel)
 
 bool ffmpeg_send_frame_flipped(FFMPEG *ffmpeg, void *data, size_t width, size_t height)
 {
-    for (size_t y = height; y > 0; --y) {
-        // TODO: write() may not necessarily write the entire row. We may want to repeat the call.
-        if (write(ffmpeg->pipe, (uint32_t*)data + (y - 1)*width, sizeof(uint32_t)*width) < 0) {
-            TraceLog(LOG_ERROR, "FFMPEG: failed to write frame into ffmpeg pipe: %s", strerror(errno));
-            return false;
-        }
-    }
-    return true;
+    if (ffmpeg->queue) return queue_push(ffmpeg->queue, data, width, height);
+    return write_frame_flipped(&ffmpeg->video, data, width, height);
+}
+
+bool ffmpeg_repeat_frame(FFMPEG *ffmpeg)
+{
+    // The video always goes through the queue, see ffmpeg_spawn()
+    assert(ffmpeg->queue != NULL);
+    return queue_push_repeat(ffmpeg->queue);
 }
 
 bool ffmpeg_send_sound_samples(FFMPEG *ffmpeg, void *data, size_t size)
 {
-    if (write(ffmpeg->pipe, data, size) < 0) {
+    if (ffmpeg->libav) return libav_send_sound_samples(ffmpeg->libav, data, size);
+
+    struct iovec iov = { .iov_base = data, .iov_len = size };
+    if (!pipe_writev(&ffmpeg->audio, &iov, 1)) {
         TraceLog(LOG_ERROR, "FFMPEG: failed to write sound into ffmpeg pipe: %s", strerror(errno));
         return false;
     }
     return true;
 }
+
+bool ffmpeg_concat_segments(const char *output_path, const char **segment_paths, size_t segment_count, const Render_Profile *profile)
+{
+    char list_path[4096];
+    snprintf(list_path, sizeof(list_path), "%s.segments.txt", output_path);
+
+    FILE *list = fopen(list_path, "w");
+    if (list == NULL) {
+        TraceLog(LOG_ERROR, "FFMPEG: could not create %s: %s", list_path, strerror(errno));
+        return false;
+    }
+    for (size_t i = 0; i < segment_count; ++i) {
+        // The paths in the list are relative to the list itself
+        const char *name = strrchr(segment_paths[i], '/');
+        name = name ? name + 1 : segment_paths[i];
+        // A quote can't be escaped inside the quotes, so it closes them,
+        // comes escaped on its own and opens them again
+        fputs("file '", list);
+        for (const char *c = name; *c != '\0'; ++c) {
+            if (*c == '\'') fputs("'\\''", list);
+            else fputc(*c, list);
+        }
+        fputs("'\n", list);
+    }
+    fclose(list);
+
+    Args args = {0};
+    append_header(&args);
+    // Nothing is piped in, so ffmpeg would read the keys of the terminal
+    args_append(&args, "-nostdin");
+    args_append(&args, "-f");    args_append(&args, "concat");
+    args_append(&args, "-safe"); args_append(&args, "0");
+    args_append(&args, "-i");    args_append(&args, list_path);
+    args_append(&args, "-c:v");  args_append(&args, "copy");
+    append_audio_output(&args, profile->audio_codec, profile->audio_bitrate);
+    args_append(&args, output_path);
+    args_append(&args, NULL);
+    FFMPEG *ffmpeg = ffmpeg_spawn(args.items, false, false, false);
+    bool ok = ffmpeg != NULL && ffmpeg_end_rendering(ffmpeg, false);
+
+    if (unlink(list_path) < 0) {
+        TraceLog(LOG_WARNING, "FFMPEG: could not remove %s: %s", list_path, strerror(errno));
+    }
+    return ok;
+}
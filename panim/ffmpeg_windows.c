@@ -17,18 +17,31 @@ struct FFMPEG {
     char dummy;
 };
 
-FFMPEG *ffmpeg_start_rendering_video(const char *output_path, size_t width, size_t height, size_t fps)
+FFMPEG *ffmpeg_start_rendering_video(const char *output_path, const Render_Profile *profile)
 {
     (void)output_path;
-    (void)width;
-    (void)height;
-    (void)fps;
+    (void)profile;
+    return NULL;
+}
+
+FFMPEG *ffmpeg_start_rendering_video_with_audio(const char *output_path, const Render_Profile *profile)
+{
+    (void)output_path;
+    (void)profile;
     return NULL;
 }
 
-FFMPEG *ffmpeg_start_rendering_audio(const char *output_path)
+FFMPEG *ffmpeg_start_rendering_segment(const char *output_path, const Render_Profile *profile)
 {
     (void)output_path;
+    (void)profile;
+    return NULL;
+}
+
+FFMPEG *ffmpeg_start_rendering_audio(const char *output_path, const Render_Profile *profile)
+{
+    (void)output_path;
+    (void)profile;
     return NULL;
 }
 
@@ -48,6 +61,12 @@ bool ffmpeg_send_frame_flipped(FFMPEG *ffmpeg, void *data, size_t width, size_t
     return false;
 }
 
+bool ffmpeg_repeat_frame(FFMPEG *ffmpeg)
+{
+    (void)ffmpeg;
+    return false;
+}
+
 bool ffmpeg_send_sound_samples(FFMPEG *ffmpeg, void *data, size_t size)
 {
     (void)ffmpeg;
@@ -55,3 +74,17 @@ bool ffmpeg_send_sound_samples(FFMPEG *ffmpeg, void *data, size_t size)
     (void)size;
     return false;
 }
+
+bool ffmpeg_concat_segments(const char *output_path, const char **segment_paths, size_t segment_count, const Render_Profile *profile)
+{
+    (void)output_path;
+    (void)segment_paths;
+    (void)segment_count;
+    (void)profile;
+    return false;
+}
+
+void ffmpeg_use_libav(bool enabled)
+{
+    (void)enabled;
+}
@@ -0,0 +1,96 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "framehash.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FRAMEHASH_AVX2
+#include <immintrin.h>
+#endif
+
+// 32 independent lanes of xxHash32 rounds over 128 byte blocks. That's 4
+// AVX2 registers, so the multiplications of one don't wait for the others.
+// Both the scalar and the AVX2 versions compute exactly the same thing.
+#define LANES 32
+#define BLOCK_SIZE (LANES*sizeof(uint32_t))
+#define PRIME32_1 0x9E3779B1u
+#define PRIME32_2 0x85EBCA77u
+#define PRIME64 0x9E3779B97F4A7C15ull
+
+static inline uint32_t rotl32(uint32_t x, int r)
+{
+    return (x << r) | (x >> (32 - r));
+}
+
+static void init_lanes(uint32_t acc[LANES])
+{
+    for (size_t i = 0; i < LANES; ++i) acc[i] = PRIME32_1*(uint32_t)(i + 1);
+}
+
+static size_t hash_blocks_scalar(const uint8_t *data, size_t size, uint32_t acc[LANES])
+{
+    size_t offset = 0;
+    for (; offset + BLOCK_SIZE <= size; offset += BLOCK_SIZE) {
+        for (size_t i = 0; i < LANES; ++i) {
+            uint32_t word;
+            memcpy(&word, data + offset + i*sizeof(uint32_t), sizeof(word));
+            acc[i] = rotl32(acc[i] + word*PRIME32_2, 13)*PRIME32_1;
+        }
+    }
+    return offset;
+}
+
+#ifdef FRAMEHASH_AVX2
+__attribute__((target("avx2")))
+static size_t hash_blocks_avx2(const uint8_t *data, size_t size, uint32_t acc[LANES])
+{
+    #define VECTORS (LANES/8)
+    __m256i a[VECTORS];
+    for (size_t j = 0; j < VECTORS; ++j) a[j] = _mm256_loadu_si256((const __m256i*)acc + j);
+    const __m256i p1 = _mm256_set1_epi32(PRIME32_1);
+    const __m256i p2 = _mm256_set1_epi32(PRIME32_2);
+    size_t offset = 0;
+    for (; offset + BLOCK_SIZE <= size; offset += BLOCK_SIZE) {
+        for (size_t j = 0; j < VECTORS; ++j) {
+            __m256i words = _mm256_loadu_si256((const __m256i*)(data + offset) + j);
+            a[j] = _mm256_add_epi32(a[j], _mm256_mullo_epi32(words, p2));
+            a[j] = _mm256_or_si256(_mm256_slli_epi32(a[j], 13), _mm256_srli_epi32(a[j], 32 - 13));
+            a[j] = _mm256_mullo_epi32(a[j], p1);
+        }
+    }
+    for (size_t j = 0; j < VECTORS; ++j) _mm256_storeu_si256((__m256i*)acc + j, a[j]);
+    #undef VECTORS
+    return offset;
+}
+
+static bool has_avx2(void)
+{
+    static int cached = -1;
+    if (cached < 0) cached = __builtin_cpu_supports("avx2") ? 1 : 0;
+    return cached;
+}
+#endif // FRAMEHASH_AVX2
+
+static inline uint64_t mix(uint64_t h, uint64_t x)
+{
+    h = (h ^ x)*PRIME64;
+    return h ^ (h >> 29);
+}
+
+uint64_t frame_hash(const void *data, size_t size)
+{
+    uint32_t acc[LANES];
+    init_lanes(acc);
+
+    size_t offset = 0;
+#ifdef FRAMEHASH_AVX2
+    if (has_avx2()) offset = hash_blocks_avx2(data, size, acc);
+    else
+#endif // FRAMEHASH_AVX2
+    offset = hash_blocks_scalar(data, size, acc);
+
+    uint64_t h = mix(PRIME64, size);
+    for (size_t i = 0; i < LANES; ++i) h = mix(h, acc[i]);
+    for (; offset < size; ++offset) h = mix(h, ((const uint8_t*)data)[offset]);
+    return h;
+}
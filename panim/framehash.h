@@ -0,0 +1,12 @@
+#ifndef FRAMEHASH_H_
+#define FRAMEHASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fast non-cryptographic hash of the pixels of a frame. Only meant to tell
+// whether two frames of the same render are identical, so the value is not
+// stable between builds. Uses AVX2 when the CPU has it.
+uint64_t frame_hash(const void *data, size_t size);
+
+#endif // FRAMEHASH_H_
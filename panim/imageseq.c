@@ -0,0 +1,459 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <raylib.h>
+
+#include "nob.h"
+#include "imageseq.h"
+
+#define MANIFEST_NAME "manifest.txt"
+
+bool image_sequence_parse_format(const char *name, Image_Sequence_Format *format)
+{
+    if (strcmp(name, "qoi") == 0) {
+        *format = IMAGE_SEQUENCE_QOI;
+        return true;
+    }
+    if (strcmp(name, "png") == 0) {
+        *format = IMAGE_SEQUENCE_PNG;
+        return true;
+    }
+    return false;
+}
+
+// Parses a `frame <index> ...` line of the manifest
+static bool parse_manifest_frame(Nob_String_View line, size_t *index)
+{
+    Nob_String_View word = nob_sv_chop_by_delim(&line, ' ');
+    if (!nob_sv_eq(word, nob_sv_from_cstr("frame"))) return false;
+
+    word = nob_sv_chop_by_delim(&line, ' ');
+    if (word.count == 0) return false;
+    size_t result = 0;
+    for (size_t i = 0; i < word.count; ++i) {
+        if (word.data[i] < '0' || word.data[i] > '9') return false;
+        result = result*10 + (word.data[i] - '0');
+    }
+    // A line that got cut off in the middle has no file name
+    if (nob_sv_trim(line).count == 0) return false;
+    *index = result;
+    return true;
+}
+
+// Loads the manifest of output_dir keeping only its header and the first
+// frames that are numbered in order. Returns how many frames were kept.
+static size_t load_manifest(const char *output_dir, Nob_String_Builder *kept)
+{
+    const char *path = nob_temp_sprintf("%s/"MANIFEST_NAME, output_dir);
+    if (!nob_file_exists(path)) return 0;
+
+    Nob_String_Builder sb = {0};
+    if (!nob_read_entire_file(path, &sb)) return 0;
+
+    size_t frames = 0;
+    Nob_String_View content = nob_sb_to_sv(sb);
+    while (content.count > 0) {
+        bool terminated = memchr(content.data, '\n', content.count) != NULL;
+        Nob_String_View line = nob_sv_chop_by_delim(&content, '\n');
+        if (!terminated) break;
+
+        size_t index = 0;
+        if (parse_manifest_frame(line, &index)) {
+            if (index != frames) break;
+            frames += 1;
+        } else if (line.count == 0 || line.data[0] != '#') {
+            break;
+        }
+        if (kept) {
+            nob_sb_append_buf(kept, line.data, line.count);
+            nob_sb_append_cstr(kept, "\n");
+        }
+    }
+
+    nob_sb_free(sb);
+    return frames;
+}
+
+size_t image_sequence_resume_point(const char *output_dir)
+{
+    return load_manifest(output_dir, NULL);
+}
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <pthread.h>
+
+// The pool never has more threads than that
+#define IMAGE_SEQUENCE_MAX_THREADS 8
+// How many frames may be queued or being encoded per thread
+#define IMAGE_SEQUENCE_FRAMES_PER_THREAD 2
+
+typedef struct {
+    size_t index;
+    // Top-down RGBA, owned by the slot and reused between frames
+    void *pixels;
+    size_t width;
+    size_t height;
+    bool repeat;
+    bool done;
+    bool ok;
+} Job;
+
+// Frames get an increasing index. The job of frame i lives in
+// jobs[i%capacity] from the moment it is submitted until it is written into
+// the manifest, which always happens in order. That bounds the amount of
+// frames in flight by capacity, and the producer blocks beyond that.
+struct Image_Sequence {
+    char *output_dir;
+    Image_Sequence_Format format;
+    size_t fps;
+    FILE *manifest;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t submitted;
+    pthread_cond_t finished;
+    Job *jobs;
+    size_t capacity;
+    size_t next_submit;
+    size_t next_take;
+    size_t next_manifest;
+    // Index of the last frame that was encoded rather than repeated
+    size_t last_encoded;
+    bool closing;
+    bool failed;
+
+    pthread_t threads[IMAGE_SEQUENCE_MAX_THREADS];
+    size_t thread_count;
+
+    // Statistics
+    size_t encoded;
+    size_t repeated;
+    double encode_secs;
+    double backpressure_secs;
+};
+
+static const char *format_extension(Image_Sequence_Format format)
+{
+    switch (format) {
+    case IMAGE_SEQUENCE_QOI: return "qoi";
+    case IMAGE_SEQUENCE_PNG: return "png";
+    }
+    assert(0 && "unreachable");
+    return NULL;
+}
+
+static void frame_file_name(Image_Sequence *seq, size_t index, char *name, size_t name_size)
+{
+    snprintf(name, name_size, "frame_%06zu.%s", index, format_extension(seq->format));
+}
+
+static void frame_path(Image_Sequence *seq, size_t index, char *path, size_t path_size)
+{
+    char name[64];
+    frame_file_name(seq, index, name, sizeof(name));
+    snprintf(path, path_size, "%s/%s", seq->output_dir, name);
+}
+
+static bool encode_job(Image_Sequence *seq, Job *job)
+{
+    char path[4096];
+    frame_path(seq, job->index, path, sizeof(path));
+    Image image = {
+        .data = job->pixels,
+        .width = job->width,
+        .height = job->height,
+        .mipmaps = 1,
+        .format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8,
+    };
+    return ExportImage(image, path);
+}
+
+// Must be called with the mutex locked. Moves the finished frames at the
+// front of the ring into the manifest.
+static void advance_manifest(Image_Sequence *seq)
+{
+    while (seq->next_manifest < seq->next_take) {
+        Job *job = &seq->jobs[seq->next_manifest%seq->capacity];
+        if (!job->done) break;
+
+        char name[64];
+        if (job->repeat) {
+            // The previous frames are all in the manifest by now, so the file we link to is complete
+            char source[4096], path[4096];
+            frame_path(seq, seq->last_encoded, source, sizeof(source));
+            frame_path(seq, job->index, path, sizeof(path));
+            unlink(path);
+            if (link(source, path) < 0) {
+                TraceLog(LOG_ERROR, "IMAGESEQ: could not link %s to %s: %s", path, source, strerror(errno));
+                job->ok = false;
+            }
+        } else {
+            seq->last_encoded = job->index;
+        }
+
+        if (!job->ok) {
+            seq->failed = true;
+            break;
+        }
+
+        frame_file_name(seq, job->index, name, sizeof(name));
+        fprintf(seq->manifest, "frame %zu %.6f %s\n", job->index, (double)job->index/seq->fps, name);
+        fflush(seq->manifest);
+        job->done = false;
+        seq->next_manifest += 1;
+    }
+    pthread_cond_broadcast(&seq->finished);
+}
+
+static void *image_sequence_worker(void *arg)
+{
+    Image_Sequence *seq = arg;
+
+    pthread_mutex_lock(&seq->mutex);
+    for (;;) {
+        while (seq->next_take == seq->next_submit && !seq->closing) {
+            pthread_cond_wait(&seq->submitted, &seq->mutex);
+        }
+        if (seq->next_take == seq->next_submit) break;
+
+        Job *job = &seq->jobs[seq->next_take%seq->capacity];
+        seq->next_take += 1;
+        // After a failure the remaining frames are only drained
+        bool failed = seq->failed;
+        pthread_mutex_unlock(&seq->mutex);
+
+        bool ok = !failed;
+        double elapsed = 0.0;
+        if (!failed && !job->repeat) {
+            double start = GetTime();
+            ok = encode_job(seq, job);
+            elapsed = GetTime() - start;
+            if (!ok) TraceLog(LOG_ERROR, "IMAGESEQ: could not write frame %zu", job->index);
+        }
+
+        pthread_mutex_lock(&seq->mutex);
+        seq->encode_secs += elapsed;
+        job->ok = ok;
+        job->done = true;
+        advance_manifest(seq);
+    }
+    pthread_mutex_unlock(&seq->mutex);
+
+    return NULL;
+}
+
+static bool open_manifest(Image_Sequence *seq, size_t first_frame)
+{
+    const char *path = nob_temp_sprintf("%s/"MANIFEST_NAME, seq->output_dir);
+
+    Nob_String_Builder header = {0};
+    if (first_frame > 0) {
+        size_t frames = load_manifest(seq->output_dir, &header);
+        if (frames < first_frame) {
+            TraceLog(LOG_ERROR, "IMAGESEQ: %s only has %zu frames, can't resume from frame %zu", path, frames, first_frame);
+            nob_sb_free(header);
+            return false;
+        }
+    } else {
+        nob_sb_append_cstr(&header, "# panim image sequence\n");
+        nob_sb_append_cstr(&header, nob_temp_sprintf("# %s\n", seq->format == IMAGE_SEQUENCE_PNG ? "png" : "qoi"));
+    }
+
+    // Rewriting it drops whatever is past the resume point
+    bool ok = nob_write_entire_file(path, header.items, header.count);
+    nob_sb_free(header);
+    if (!ok) return false;
+
+    seq->manifest = fopen(path, "a");
+    if (seq->manifest == NULL) {
+        TraceLog(LOG_ERROR, "IMAGESEQ: could not open %s: %s", path, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+Image_Sequence *image_sequence_start(const char *output_dir, const Render_Profile *profile, Image_Sequence_Format format, size_t first_frame)
+{
+    if (!nob_mkdir_if_not_exists(output_dir)) return NULL;
+
+    Image_Sequence *seq = malloc(sizeof(Image_Sequence));
+    assert(seq != NULL && "Buy MORE RAM lol!!");
+    memset(seq, 0, sizeof(*seq));
+    seq->output_dir = strdup(output_dir);
+    assert(seq->output_dir != NULL && "Buy MORE RAM lol!!");
+    seq->format = format;
+    seq->fps = profile->fps;
+    seq->next_submit = first_frame;
+    seq->next_take = first_frame;
+    seq->next_manifest = first_frame;
+    // A repeated first frame links to the last frame of the previous render
+    seq->last_encoded = first_frame > 0 ? first_frame - 1 : 0;
+
+    if (!open_manifest(seq, first_frame)) {
+        free(seq->output_dir);
+        free(seq);
+        return NULL;
+    }
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    seq->thread_count = cpus < 1 ? 1 : cpus < IMAGE_SEQUENCE_MAX_THREADS ? (size_t)cpus : IMAGE_SEQUENCE_MAX_THREADS;
+    seq->capacity = seq->thread_count*IMAGE_SEQUENCE_FRAMES_PER_THREAD;
+    seq->jobs = calloc(seq->capacity, sizeof(*seq->jobs));
+    assert(seq->jobs != NULL && "Buy MORE RAM lol!!");
+
+    pthread_mutex_init(&seq->mutex, NULL);
+    pthread_cond_init(&seq->submitted, NULL);
+    pthread_cond_init(&seq->finished, NULL);
+    size_t started = 0;
+    for (; started < seq->thread_count; ++started) {
+        int err = pthread_create(&seq->threads[started], NULL, image_sequence_worker, seq);
+        if (err != 0) {
+            TraceLog(LOG_WARNING, "IMAGESEQ: could not start a worker thread: %s", strerror(err));
+            break;
+        }
+    }
+    seq->thread_count = started;
+    if (started == 0) {
+        image_sequence_end(seq, true);
+        return NULL;
+    }
+
+    TraceLog(LOG_INFO, "IMAGESEQ: writing %s frames into %s from frame %zu on %zu threads",
+             format_extension(format), output_dir, first_frame, seq->thread_count);
+    return seq;
+}
+
+// Waits for a free slot and returns it with the mutex locked
+static Job *reserve_job(Image_Sequence *seq)
+{
+    pthread_mutex_lock(&seq->mutex);
+    if (seq->next_submit - seq->next_manifest >= seq->capacity) {
+        double start = GetTime();
+        while (seq->next_submit - seq->next_manifest >= seq->capacity && !seq->failed) {
+            pthread_cond_wait(&seq->finished, &seq->mutex);
+        }
+        seq->backpressure_secs += GetTime() - start;
+    }
+    if (seq->failed) {
+        pthread_mutex_unlock(&seq->mutex);
+        return NULL;
+    }
+
+    Job *job = &seq->jobs[seq->next_submit%seq->capacity];
+    job->index = seq->next_submit;
+    job->done = false;
+    job->ok = false;
+    return job;
+}
+
+static void submit_job(Image_Sequence *seq)
+{
+    seq->next_submit += 1;
+    pthread_cond_signal(&seq->submitted);
+    pthread_mutex_unlock(&seq->mutex);
+}
+
+bool image_sequence_send_frame_flipped(Image_Sequence *seq, void *data, size_t width, size_t height)
+{
+    Job *job = reserve_job(seq);
+    if (job == NULL) return false;
+    // Nobody else touches the slot until it is submitted
+    pthread_mutex_unlock(&seq->mutex);
+
+    if (job->pixels == NULL || job->width != width || job->height != height) {
+        free(job->pixels);
+        job->pixels = malloc(sizeof(uint32_t)*width*height);
+        assert(job->pixels != NULL && "Buy MORE RAM lol!!");
+        job->width = width;
+        job->height = height;
+    }
+    size_t stride = sizeof(uint32_t)*width;
+    for (size_t y = 0; y < height; ++y) {
+        memcpy((uint8_t*)job->pixels + y*stride, (uint8_t*)data + (height - 1 - y)*stride, stride);
+    }
+    job->repeat = false;
+
+    pthread_mutex_lock(&seq->mutex);
+    seq->encoded += 1;
+    submit_job(seq);
+    return true;
+}
+
+bool image_sequence_repeat_frame(Image_Sequence *seq)
+{
+    Job *job = reserve_job(seq);
+    if (job == NULL) return false;
+    job->repeat = true;
+    seq->repeated += 1;
+    submit_job(seq);
+    return true;
+}
+
+bool image_sequence_end(Image_Sequence *seq, bool cancel)
+{
+    pthread_mutex_lock(&seq->mutex);
+    if (cancel) seq->failed = true;
+    seq->closing = true;
+    pthread_cond_broadcast(&seq->submitted);
+    pthread_mutex_unlock(&seq->mutex);
+    for (size_t i = 0; i < seq->thread_count; ++i) {
+        pthread_join(seq->threads[i], NULL);
+    }
+
+    bool ok = !seq->failed && seq->next_manifest == seq->next_submit;
+    if (seq->encoded > 0) {
+        TraceLog(LOG_INFO, "IMAGESEQ: %zu frames encoded in %.2fs of worker time (%.2fms per frame), %zu repeated",
+                 seq->encoded, seq->encode_secs, seq->encode_secs*1000.0/seq->encoded, seq->repeated);
+        TraceLog(LOG_INFO, "IMAGESEQ: %.3fs spent waiting on the workers", seq->backpressure_secs);
+    }
+    TraceLog(ok ? LOG_INFO : LOG_WARNING, "IMAGESEQ: %zu frames in %s/"MANIFEST_NAME,
+             seq->next_manifest, seq->output_dir);
+
+    if (seq->manifest) fclose(seq->manifest);
+    for (size_t i = 0; i < seq->capacity; ++i) free(seq->jobs[i].pixels);
+    free(seq->jobs);
+    pthread_cond_destroy(&seq->submitted);
+    pthread_cond_destroy(&seq->finished);
+    pthread_mutex_destroy(&seq->mutex);
+    free(seq->output_dir);
+    free(seq);
+    return ok;
+}
+#else
+// main() refuses --image-sequence on Windows, so these are never reached
+Image_Sequence *image_sequence_start(const char *output_dir, const Render_Profile *profile, Image_Sequence_Format format, size_t first_frame)
+{
+    (void)output_dir;
+    (void)profile;
+    (void)format;
+    (void)first_frame;
+    TraceLog(LOG_ERROR, "IMAGESEQ: image sequences are not supported on Windows yet");
+    return NULL;
+}
+
+bool image_sequence_send_frame_flipped(Image_Sequence *seq, void *data, size_t width, size_t height)
+{
+    (void)seq;
+    (void)data;
+    (void)width;
+    (void)height;
+    return false;
+}
+
+bool image_sequence_repeat_frame(Image_Sequence *seq)
+{
+    (void)seq;
+    return false;
+}
+
+bool image_sequence_end(Image_Sequence *seq, bool cancel)
+{
+    (void)seq;
+    (void)cancel;
+    return false;
+}
+#endif // _WIN32
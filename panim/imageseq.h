@@ -0,0 +1,42 @@
+#ifndef IMAGESEQ_H_
+#define IMAGESEQ_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "profile.h"
+
+// Alternative to the ffmpeg output for compositing: every frame becomes a
+// numbered image in a directory (frame_000000.png, ...). The images are
+// encoded by a pool of threads while the next frames are being rendered.
+//
+// Next to the images lives manifest.txt with a line per frame that is fully
+// written:
+//
+//     frame <index> <time in seconds> <file name>
+//
+// The frames are always added to the manifest in order, so after an
+// interrupted render everything it lists can be trusted and the render can
+// pick up from image_sequence_resume_point().
+
+typedef struct Image_Sequence Image_Sequence;
+
+typedef enum {
+    IMAGE_SEQUENCE_QOI, // Fast to encode, but few tools read it
+    IMAGE_SEQUENCE_PNG, // Slow to encode, everything reads it
+} Image_Sequence_Format;
+
+bool image_sequence_parse_format(const char *name, Image_Sequence_Format *format);
+// Starts writing frames into output_dir beginning with first_frame. With
+// first_frame > 0 the existing manifest is appended to.
+Image_Sequence *image_sequence_start(const char *output_dir, const Render_Profile *profile, Image_Sequence_Format format, size_t first_frame);
+// data is bottom-up RGBA, the same as for ffmpeg_send_frame_flipped()
+bool image_sequence_send_frame_flipped(Image_Sequence *seq, void *data, size_t width, size_t height);
+// The frame is the same as the previous one, so it becomes a hard link to its image
+bool image_sequence_repeat_frame(Image_Sequence *seq);
+// Waits for all the frames to be written. Returns false if any of them failed.
+bool image_sequence_end(Image_Sequence *seq, bool cancel);
+// How many frames of output_dir are already complete according to its manifest
+size_t image_sequence_resume_point(const char *output_dir);
+
+#endif // IMAGESEQ_H_
@@ -0,0 +1,610 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <dlfcn.h>
+#include <pthread.h>
+
+#include <raylib.h>
+
+#include "libav.h"
+#include "yuv.h"
+
+// There are no FFmpeg headers to build against, so everything below is
+// declared by hand. Structs are opaque pointers and the few fields we need
+// are read at fixed offsets, which are taken from the public headers of the
+// releases listed in releases[] below. Libraries of any other version are not
+// used at all, and on top of that the offsets are checked on real objects in
+// libav_start() wherever that is possible.
+
+typedef struct {
+    int num;
+    int den;
+} Libav_Rational;
+
+#define LIST_OF_LIBAV_FUNCS \
+    LIBAV(avutil, unsigned, avutil_version, void) \
+    LIBAV(avutil, void*, av_frame_alloc, void) \
+    LIBAV(avutil, void, av_frame_free, void **frame) \
+    LIBAV(avutil, int, av_frame_get_buffer, void *frame, int align) \
+    LIBAV(avutil, int, av_frame_make_writable, void *frame) \
+    LIBAV(avutil, int, av_opt_set, void *obj, const char *name, const char *val, int search_flags) \
+    LIBAV(avutil, int, av_opt_get_int, void *obj, const char *name, int search_flags, int64_t *out_val) \
+    LIBAV(avutil, int, av_strerror, int errnum, char *errbuf, size_t errbuf_size) \
+    LIBAV(avcodec, unsigned, avcodec_version, void) \
+    LIBAV(avcodec, const void*, avcodec_find_encoder_by_name, const char *name) \
+    LIBAV(avcodec, const void*, avcodec_find_decoder_by_name, const char *name) \
+    LIBAV(avcodec, void*, avcodec_alloc_context3, const void *codec) \
+    LIBAV(avcodec, void, avcodec_free_context, void **ctx) \
+    LIBAV(avcodec, int, avcodec_open2, void *ctx, const void *codec, void **options) \
+    LIBAV(avcodec, int, avcodec_send_frame, void *ctx, const void *frame) \
+    LIBAV(avcodec, int, avcodec_receive_packet, void *ctx, void *packet) \
+    LIBAV(avcodec, int, avcodec_send_packet, void *ctx, const void *packet) \
+    LIBAV(avcodec, int, avcodec_receive_frame, void *ctx, void *frame) \
+    LIBAV(avcodec, int, avcodec_parameters_from_context, void *par, const void *ctx) \
+    LIBAV(avcodec, void*, av_packet_alloc, void) \
+    LIBAV(avcodec, void, av_packet_free, void **packet) \
+    LIBAV(avcodec, int, av_new_packet, void *packet, int size) \
+    LIBAV(avcodec, void, av_packet_rescale_ts, void *packet, Libav_Rational src, Libav_Rational dst) \
+    LIBAV(avformat, unsigned, avformat_version, void) \
+    LIBAV(avformat, const void*, avformat_get_class, void) \
+    LIBAV(avformat, const void*, av_stream_get_class, void) \
+    LIBAV(avformat, int, avformat_alloc_output_context2, void **ctx, const void *oformat, const char *format_name, const char *filename) \
+    LIBAV(avformat, void, avformat_free_context, void *ctx) \
+    LIBAV(avformat, void*, avformat_new_stream, void *ctx, const void *codec) \
+    LIBAV(avformat, int, avformat_write_header, void *ctx, void **options) \
+    LIBAV(avformat, int, av_interleaved_write_frame, void *ctx, void *packet) \
+    LIBAV(avformat, int, av_write_trailer, void *ctx) \
+    LIBAV(avformat, int, avio_open, void **pb, const char *url, int flags) \
+    LIBAV(avformat, int, avio_closep, void **pb)
+
+#define LIBAV(lib, ret, name, ...) static ret (*name)(__VA_ARGS__);
+LIST_OF_LIBAV_FUNCS
+#undef LIBAV
+
+#define FIELD(type, ptr, offset) (*(type*)((uint8_t*)(ptr) + (offset)))
+
+// AVFrame
+#define FRAME_DATA(frame, i)        FIELD(uint8_t*, frame, 8*(i))
+#define FRAME_LINESIZE(frame, i)    FIELD(int, frame, 64 + 4*(i))
+#define FRAME_EXTENDED_DATA(frame)  FIELD(uint8_t**, frame, 96)
+#define FRAME_WIDTH(frame)          FIELD(int, frame, 104)
+#define FRAME_HEIGHT(frame)         FIELD(int, frame, 108)
+#define FRAME_NB_SAMPLES(frame)     FIELD(int, frame, 112)
+#define FRAME_FORMAT(frame)         FIELD(int, frame, 116)
+#define FRAME_PTS(frame)            FIELD(int64_t, frame, 136)
+// AVPacket
+#define PACKET_DATA(packet)         FIELD(uint8_t*, packet, 24)
+#define PACKET_STREAM_INDEX(packet) FIELD(int, packet, 36)
+// AVFormatContext
+#define FORMAT_CLASS(format)        FIELD(const void*, format, 0)
+#define FORMAT_OFORMAT(format)      FIELD(const void*, format, 16)
+#define FORMAT_PB(format)           FIELD(void*, format, 32)
+// AVOutputFormat
+#define OFORMAT_FLAGS(oformat)      FIELD(int, oformat, 44)
+// AVStream
+#define STREAM_CLASS(stream)        FIELD(const void*, stream, 0)
+#define STREAM_INDEX(stream)        FIELD(int, stream, 8)
+#define STREAM_CODECPAR(stream)     FIELD(void*, stream, 16)
+#define STREAM_TIME_BASE(stream)    FIELD(Libav_Rational, stream, 32)
+
+#define AV_NOPTS_VALUE ((int64_t)UINT64_C(0x8000000000000000))
+#define AVERROR_EOF (-(int)('E' | ('O' << 8) | ('F' << 16) | ((unsigned)' ' << 24)))
+#define AV_PIX_FMT_YUV420P 0
+#define AV_SAMPLE_FMT_S32P 7
+#define AV_SAMPLE_FMT_FLTP 8
+#define AV_OPT_SEARCH_CHILDREN 1
+#define AVIO_FLAG_WRITE 2
+#define AVFMT_NOFILE 0x0001
+#define AVFMT_GLOBALHEADER 0x0040
+
+// The releases the offsets above are known to match, newest first. The same
+// release has to provide all three libraries and their major versions have to
+// be the ones listed, whatever their sonames say.
+static const struct {
+    const char *sonames[3];
+    unsigned majors[3];
+} releases[] = {
+    {{"libavutil.so.59", "libavcodec.so.61", "libavformat.so.61"}, {59, 61, 61}}, // FFmpeg 7
+    {{"libavutil.so.58", "libavcodec.so.60", "libavformat.so.60"}, {58, 60, 60}}, // FFmpeg 6
+};
+
+typedef struct {
+    void *codec;    // AVCodecContext
+    void *stream;   // AVStream
+    void *frame;    // AVFrame we fill and hand over to the encoder
+    void *packet;   // AVPacket we receive the encoded data into
+    Libav_Rational time_base;
+    int64_t next_pts;
+    int index;
+} Libav_Stream;
+
+struct Libav {
+    void *format;   // AVFormatContext
+    // Taken around the muxer, which gets packets from both the video and the sound thread
+    pthread_mutex_t mux;
+    Libav_Stream video;
+    Libav_Stream audio;
+    bool has_audio;
+    size_t channels;
+    // How many samples per channel the sound frame takes, and how many it already has
+    size_t frame_size;
+    size_t filled;
+
+    // Set when the last frames were repeats, so the last frame that was sent
+    // has to be sent once more at the end to make it last until then
+    bool repeating;
+
+    // Statistics
+    size_t frames;
+    size_t repeats;
+    double video_secs;
+};
+
+static double now_secs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static void log_error(const char *what, int err)
+{
+    char message[128];
+    if (av_strerror(err, message, sizeof(message)) < 0) snprintf(message, sizeof(message), "error %d", err);
+    TraceLog(LOG_ERROR, "LIBAV: %s: %s", what, message);
+}
+
+static bool load_libs(const char *const names[3], const unsigned majors[3])
+{
+    void *libs[3] = {0};
+    for (size_t i = 0; i < 3; ++i) {
+        libs[i] = dlopen(names[i], RTLD_NOW | RTLD_LOCAL);
+        if (libs[i] == NULL) goto fail;
+    }
+    void *avutil = libs[0], *avcodec = libs[1], *avformat = libs[2];
+
+    #define LIBAV(lib, ret, name, ...) \
+        name = dlsym(lib, #name); \
+        if (name == NULL) { \
+            TraceLog(LOG_WARNING, "LIBAV: could not find %s in lib%s", #name, #lib); \
+            goto fail; \
+        }
+    LIST_OF_LIBAV_FUNCS
+    #undef LIBAV
+
+    TraceLog(LOG_INFO, "LIBAV: loaded libavutil %u.%u, libavcodec %u.%u, libavformat %u.%u",
+             avutil_version() >> 16, (avutil_version() >> 8)&0xFF,
+             avcodec_version() >> 16, (avcodec_version() >> 8)&0xFF,
+             avformat_version() >> 16, (avformat_version() >> 8)&0xFF);
+    if (avutil_version() >> 16 != majors[0] || avcodec_version() >> 16 != majors[1] || avformat_version() >> 16 != majors[2]) {
+        TraceLog(LOG_WARNING, "LIBAV: expected libavutil %u, libavcodec %u and libavformat %u, the layout of their structs is not known otherwise",
+                 majors[0], majors[1], majors[2]);
+        goto fail;
+    }
+    return true;
+
+fail:
+    for (size_t i = 0; i < 3; ++i) {
+        if (libs[i]) dlclose(libs[i]);
+    }
+    return false;
+}
+
+// Loads the libraries once and checks the fields of AVFrame that don't depend
+// on what we are encoding. AVFormatContext and AVStream are checked as soon
+// as they exist.
+static bool load(void)
+{
+    static bool tried = false;
+    static bool loaded = false;
+    if (tried) return loaded;
+    tried = true;
+
+    for (size_t i = 0; i < sizeof(releases)/sizeof(releases[0]) && !loaded; ++i) {
+        loaded = load_libs(releases[i].sonames, releases[i].majors);
+    }
+    if (!loaded) {
+        TraceLog(LOG_INFO, "LIBAV: libavcodec and libavformat are not available");
+        return false;
+    }
+
+    // A fresh AVFrame has no timestamp, no format, and extended_data pointing at data
+    void *frame = av_frame_alloc();
+    assert(frame != NULL && "Buy MORE RAM lol!!");
+    loaded = FRAME_PTS(frame) == AV_NOPTS_VALUE
+          && FRAME_FORMAT(frame) == -1
+          && FRAME_EXTENDED_DATA(frame) == &FRAME_DATA(frame, 0);
+    av_frame_free(&frame);
+    if (!loaded) TraceLog(LOG_WARNING, "LIBAV: AVFrame does not have the layout we expect");
+    return loaded;
+}
+
+static bool set_option(void *obj, const char *name, const char *value, int flags)
+{
+    int err = av_opt_set(obj, name, value, flags);
+    if (err < 0) {
+        char what[128];
+        snprintf(what, sizeof(what), "could not set %s to %s", name, value);
+        log_error(what, err);
+        return false;
+    }
+    return true;
+}
+
+static bool add_stream(Libav *libav, Libav_Stream *s)
+{
+    s->stream = avformat_new_stream(libav->format, NULL);
+    if (s->stream == NULL) {
+        TraceLog(LOG_ERROR, "LIBAV: could not add a stream");
+        return false;
+    }
+    s->index = STREAM_INDEX(s->stream);
+    if (STREAM_CLASS(s->stream) != av_stream_get_class()) {
+        TraceLog(LOG_WARNING, "LIBAV: AVStream does not have the layout we expect");
+        return false;
+    }
+    STREAM_TIME_BASE(s->stream) = s->time_base;
+
+    s->packet = av_packet_alloc();
+    assert(s->packet != NULL && "Buy MORE RAM lol!!");
+    return true;
+}
+
+// Opens the encoder once all the options are set and publishes its parameters on the stream
+static bool open_codec(Libav *libav, Libav_Stream *s, const void *codec)
+{
+    if (OFORMAT_FLAGS(FORMAT_OFORMAT(libav->format)) & AVFMT_GLOBALHEADER) {
+        if (!set_option(s->codec, "flags", "+global_header", 0)) return false;
+    }
+
+    int err = avcodec_open2(s->codec, codec, NULL);
+    if (err < 0) {
+        log_error("could not open the encoder", err);
+        return false;
+    }
+    err = avcodec_parameters_from_context(STREAM_CODECPAR(s->stream), s->codec);
+    if (err < 0) {
+        log_error("could not copy the encoder parameters", err);
+        return false;
+    }
+    return true;
+}
+
+static bool start_video(Libav *libav, const Render_Profile *profile)
+{
+    Libav_Stream *s = &libav->video;
+    s->time_base = (Libav_Rational) {1, profile->fps};
+    if (!add_stream(libav, s)) return false;
+
+    const void *codec = avcodec_find_encoder_by_name(profile->video_codec);
+    if (codec == NULL) {
+        TraceLog(LOG_WARNING, "LIBAV: there is no %s encoder", profile->video_codec);
+        return false;
+    }
+    s->codec = avcodec_alloc_context3(codec);
+    assert(s->codec != NULL && "Buy MORE RAM lol!!");
+
+    char value[64];
+    snprintf(value, sizeof(value), "%zux%zu", profile->width, profile->height);
+    if (!set_option(s->codec, "video_size", value, 0)) return false;
+    if (!set_option(s->codec, "pixel_format", "yuv420p", 0)) return false;
+    snprintf(value, sizeof(value), "1/%zu", profile->fps);
+    if (!set_option(s->codec, "time_base", value, 0)) return false;
+    snprintf(value, sizeof(value), "%zu/1", profile->fps);
+    if (!set_option(s->codec, "framerate", value, 0)) return false;
+    if (profile->video_bitrate[0] != '\0') {
+        if (!set_option(s->codec, "b", profile->video_bitrate, 0)) return false;
+    } else {
+        snprintf(value, sizeof(value), "%d", profile->crf);
+        if (!set_option(s->codec, "crf", value, AV_OPT_SEARCH_CHILDREN)) return false;
+    }
+    if (profile->preset[0] != '\0') {
+        if (!set_option(s->codec, "preset", profile->preset, AV_OPT_SEARCH_CHILDREN)) return false;
+    }
+    if (!open_codec(libav, s, codec)) return false;
+
+    s->frame = av_frame_alloc();
+    assert(s->frame != NULL && "Buy MORE RAM lol!!");
+    FRAME_WIDTH(s->frame) = profile->width;
+    FRAME_HEIGHT(s->frame) = profile->height;
+    FRAME_FORMAT(s->frame) = AV_PIX_FMT_YUV420P;
+    int err = av_frame_get_buffer(s->frame, 0);
+    if (err < 0) {
+        log_error("could not allocate a video frame", err);
+        return false;
+    }
+    return true;
+}
+
+// An AVFrame with sound needs its AVChannelLayout set, which lives too far
+// into the struct to trust its offset. So the frame is taken from a decoder
+// that has the layout instead: pcm_s32le_planar hands out one plane of s32
+// samples per channel. A plane of floats takes exactly as many bytes, so the
+// frame is switched over to fltp, which is what aac and most other encoders
+// take, before anything is written into it.
+static void *make_audio_frame(const char *layout, const Render_Profile *profile, size_t frame_size)
+{
+    const void *codec = avcodec_find_decoder_by_name("pcm_s32le_planar");
+    if (codec == NULL) return NULL;
+    void *decoder = avcodec_alloc_context3(codec);
+    assert(decoder != NULL && "Buy MORE RAM lol!!");
+    void *packet = av_packet_alloc();
+    void *frame = av_frame_alloc();
+    assert(packet != NULL && frame != NULL && "Buy MORE RAM lol!!");
+
+    bool ok = false;
+    char sample_rate[32];
+    snprintf(sample_rate, sizeof(sample_rate), "%zu", profile->sample_rate);
+    if (!set_option(decoder, "ch_layout", layout, 0)) goto defer;
+    if (!set_option(decoder, "ar", sample_rate, 0)) goto defer;
+    if (avcodec_open2(decoder, codec, NULL) < 0) goto defer;
+
+    size_t size = frame_size*profile->channels*sizeof(int32_t);
+    if (av_new_packet(packet, size) < 0) goto defer;
+    memset(PACKET_DATA(packet), 0, size);
+    if (avcodec_send_packet(decoder, packet) < 0) goto defer;
+    if (avcodec_receive_frame(decoder, frame) < 0) goto defer;
+
+    ok = FRAME_FORMAT(frame) == AV_SAMPLE_FMT_S32P && FRAME_NB_SAMPLES(frame) == (int)frame_size;
+    if (ok) FRAME_FORMAT(frame) = AV_SAMPLE_FMT_FLTP;
+
+defer:
+    if (!ok) {
+        TraceLog(LOG_WARNING, "LIBAV: could not make a frame for the sound");
+        av_frame_free(&frame);
+    }
+    av_packet_free(&packet);
+    avcodec_free_context(&decoder);
+    return frame;
+}
+
+static bool start_audio(Libav *libav, const Render_Profile *profile)
+{
+    const char *layout = profile->channels == 1 ? "mono" : profile->channels == 2 ? "stereo" : NULL;
+    if (layout == NULL) {
+        TraceLog(LOG_WARNING, "LIBAV: %zu channels are not supported", profile->channels);
+        return false;
+    }
+
+    Libav_Stream *s = &libav->audio;
+    s->time_base = (Libav_Rational) {1, profile->sample_rate};
+    if (!add_stream(libav, s)) return false;
+
+    const void *codec = avcodec_find_encoder_by_name(profile->audio_codec);
+    if (codec == NULL) {
+        TraceLog(LOG_WARNING, "LIBAV: there is no %s encoder", profile->audio_codec);
+        return false;
+    }
+    s->codec = avcodec_alloc_context3(codec);
+    assert(s->codec != NULL && "Buy MORE RAM lol!!");
+
+    char value[64];
+    snprintf(value, sizeof(value), "%zu", profile->sample_rate);
+    if (!set_option(s->codec, "ar", value, 0)) return false;
+    if (!set_option(s->codec, "ch_layout", layout, 0)) return false;
+    // Encoders that don't take planar floats leave us with the CLI
+    if (!set_option(s->codec, "sample_fmt", "fltp", 0)) return false;
+    snprintf(value, sizeof(value), "1/%zu", profile->sample_rate);
+    if (!set_option(s->codec, "time_base", value, 0)) return false;
+    if (profile->audio_bitrate[0] != '\0') {
+        if (!set_option(s->codec, "b", profile->audio_bitrate, 0)) return false;
+    }
+    if (!open_codec(libav, s, codec)) return false;
+
+    // Zero means the encoder takes any amount of samples
+    int64_t frame_size = 0;
+    if (av_opt_get_int(s->codec, "frame_size", 0, &frame_size) < 0 || frame_size <= 0) frame_size = 1024;
+    libav->frame_size = frame_size;
+    libav->channels = profile->channels;
+
+    s->frame = make_audio_frame(layout, profile, libav->frame_size);
+    return s->frame != NULL;
+}
+
+static void free_stream(Libav_Stream *s)
+{
+    if (s->frame) av_frame_free(&s->frame);
+    if (s->packet) av_packet_free(&s->packet);
+    if (s->codec) avcodec_free_context(&s->codec);
+}
+
+static void free_libav(Libav *libav)
+{
+    free_stream(&libav->video);
+    free_stream(&libav->audio);
+    if (FORMAT_PB(libav->format)) avio_closep(&FORMAT_PB(libav->format));
+    avformat_free_context(libav->format);
+    pthread_mutex_destroy(&libav->mux);
+    free(libav);
+}
+
+Libav *libav_start(const char *output_path, const Render_Profile *profile, bool audio)
+{
+    if (!load()) return NULL;
+
+    Libav *libav = malloc(sizeof(Libav));
+    assert(libav != NULL && "Buy MORE RAM lol!!");
+    memset(libav, 0, sizeof(*libav));
+    pthread_mutex_init(&libav->mux, NULL);
+    libav->has_audio = audio;
+
+    int err = avformat_alloc_output_context2(&libav->format, NULL, NULL, output_path);
+    if (err < 0) {
+        log_error("could not find a muxer for the output", err);
+        pthread_mutex_destroy(&libav->mux);
+        free(libav);
+        return NULL;
+    }
+    if (FORMAT_CLASS(libav->format) != avformat_get_class()) {
+        // Not even pb can be trusted, so free_libav() is out of the question
+        TraceLog(LOG_WARNING, "LIBAV: AVFormatContext does not have the layout we expect");
+        avformat_free_context(libav->format);
+        pthread_mutex_destroy(&libav->mux);
+        free(libav);
+        return NULL;
+    }
+
+    if (!start_video(libav, profile)) goto fail;
+    if (audio && !start_audio(libav, profile)) goto fail;
+
+    if (!(OFORMAT_FLAGS(FORMAT_OFORMAT(libav->format)) & AVFMT_NOFILE)) {
+        err = avio_open(&FORMAT_PB(libav->format), output_path, AVIO_FLAG_WRITE);
+        if (err < 0) {
+            log_error(output_path, err);
+            goto fail;
+        }
+    }
+    err = avformat_write_header(libav->format, NULL);
+    if (err < 0) {
+        log_error("could not write the header", err);
+        goto fail;
+    }
+
+    TraceLog(LOG_INFO, "LIBAV: encoding %s in-process with %s%s%s", output_path,
+             profile->video_codec, audio ? " and " : "", audio ? profile->audio_codec : "");
+    return libav;
+
+fail:
+    TraceLog(LOG_WARNING, "LIBAV: could not encode %s in-process", output_path);
+    free_libav(libav);
+    return NULL;
+}
+
+// Hands frame to the encoder (NULL drains it) and muxes whatever comes out
+static bool encode(Libav *libav, Libav_Stream *s, void *frame)
+{
+    int err = avcodec_send_frame(s->codec, frame);
+    if (err < 0) {
+        log_error("could not send a frame to the encoder", err);
+        return false;
+    }
+
+    for (;;) {
+        err = avcodec_receive_packet(s->codec, s->packet);
+        if (err == -EAGAIN || err == AVERROR_EOF) return true;
+        if (err < 0) {
+            log_error("could not encode a frame", err);
+            return false;
+        }
+
+        // The muxer may have picked a different time base in avformat_write_header()
+        av_packet_rescale_ts(s->packet, s->time_base, STREAM_TIME_BASE(s->stream));
+        PACKET_STREAM_INDEX(s->packet) = s->index;
+        pthread_mutex_lock(&libav->mux);
+        err = av_interleaved_write_frame(libav->format, s->packet);
+        pthread_mutex_unlock(&libav->mux);
+        if (err < 0) {
+            log_error("could not write a packet", err);
+            return false;
+        }
+    }
+}
+
+bool libav_send_video(Libav *libav, const uint8_t *yuv)
+{
+    double start = now_secs();
+    Libav_Stream *s = &libav->video;
+
+    // The encoder may still hold on to the buffers of the previous frame
+    int err = av_frame_make_writable(s->frame);
+    if (err < 0) {
+        log_error("could not get a video frame", err);
+        return false;
+    }
+
+    int width = FRAME_WIDTH(s->frame);
+    int height = FRAME_HEIGHT(s->frame);
+    for (int plane = 0; plane < 3; ++plane) {
+        int plane_width = plane == 0 ? width : (width + 1)/2;
+        int plane_height = plane == 0 ? height : (height + 1)/2;
+        uint8_t *dst = FRAME_DATA(s->frame, plane);
+        int linesize = FRAME_LINESIZE(s->frame, plane);
+        for (int y = 0; y < plane_height; ++y) {
+            memcpy(dst + y*linesize, yuv, plane_width);
+            yuv += plane_width;
+        }
+    }
+
+    FRAME_PTS(s->frame) = s->next_pts++;
+    bool ok = encode(libav, s, s->frame);
+    libav->repeating = false;
+    libav->frames += 1;
+    libav->video_secs += now_secs() - start;
+    return ok;
+}
+
+bool libav_repeat_video(Libav *libav)
+{
+    libav->video.next_pts += 1;
+    libav->repeating = true;
+    libav->repeats += 1;
+    return true;
+}
+
+static bool send_audio_frame(Libav *libav)
+{
+    Libav_Stream *s = &libav->audio;
+    FRAME_NB_SAMPLES(s->frame) = libav->filled;
+    FRAME_PTS(s->frame) = s->next_pts;
+    s->next_pts += libav->filled;
+    libav->filled = 0;
+    return encode(libav, s, s->frame);
+}
+
+bool libav_send_sound_samples(Libav *libav, const void *data, size_t size)
+{
+    assert(libav->has_audio);
+    Libav_Stream *s = &libav->audio;
+    const int16_t *samples = data;
+    size_t count = size/(sizeof(int16_t)*libav->channels);
+
+    for (size_t i = 0; i < count; ++i) {
+        if (libav->filled == 0) {
+            int err = av_frame_make_writable(s->frame);
+            if (err < 0) {
+                log_error("could not get a sound frame", err);
+                return false;
+            }
+        }
+        for (size_t c = 0; c < libav->channels; ++c) {
+            float *plane = (float*)FRAME_DATA(s->frame, c);
+            plane[libav->filled] = samples[i*libav->channels + c]/32768.0f;
+        }
+        libav->filled += 1;
+        if (libav->filled == libav->frame_size && !send_audio_frame(libav)) return false;
+    }
+    return true;
+}
+
+bool libav_end(Libav *libav, bool cancel)
+{
+    bool ok = !cancel;
+    if (!cancel) {
+        if (libav->has_audio && libav->filled > 0 && !send_audio_frame(libav)) ok = false;
+        if (ok && libav->repeating) {
+            // The frame still holds the last picture that was sent
+            FRAME_PTS(libav->video.frame) = libav->video.next_pts - 1;
+            if (!encode(libav, &libav->video, libav->video.frame)) ok = false;
+        }
+        if (ok && !encode(libav, &libav->video, NULL)) ok = false;
+        if (ok && libav->has_audio && !encode(libav, &libav->audio, NULL)) ok = false;
+        int err = av_write_trailer(libav->format);
+        if (err < 0) {
+            log_error("could not write the trailer", err);
+            ok = false;
+        }
+    }
+
+    if (libav->frames > 0) {
+        TraceLog(LOG_INFO, "LIBAV: %zu frames, %.3fs in the video encoder (%.2fms per frame)",
+                 libav->frames, libav->video_secs, libav->video_secs*1000.0/libav->frames);
+        TraceLog(LOG_INFO, "LIBAV: %zu repeated frames were not encoded, only their timestamps were skipped", libav->repeats);
+    }
+    free_libav(libav);
+    return ok;
+}
@@ -0,0 +1,31 @@
+#ifndef LIBAV_H_
+#define LIBAV_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "profile.h"
+
+// Encoding and muxing inside of our own process with libavcodec and
+// libavformat, which are loaded with dlopen() the first time they are needed.
+// Panim does not need their headers to build, nor the libraries to run: when
+// they are missing, or don't look like the ones we expect, libav_start()
+// returns NULL and the caller goes back to piping into the ffmpeg CLI.
+
+typedef struct Libav Libav;
+
+// The video is encoded from yuv420p frames. With audio the sound is encoded as
+// well, from the interleaved s16le samples that the ffmpeg CLI would get.
+Libav *libav_start(const char *output_path, const Render_Profile *profile, bool audio);
+// yuv is a whole frame laid out the way yuv420p_size() describes. It is
+// called from the writer thread of the video while the sound comes from the
+// render loop, which is fine as long as each of them sticks to one thread.
+bool libav_send_video(Libav *libav, const uint8_t *yuv);
+// Shows the previous frame for one more frame. Nothing is encoded, the next
+// frame just gets a later timestamp.
+bool libav_repeat_video(Libav *libav);
+bool libav_send_sound_samples(Libav *libav, const void *data, size_t size);
+bool libav_end(Libav *libav, bool cancel);
+
+#endif // LIBAV_H_
@@ -0,0 +1,193 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <raylib.h>
+
+#include "mixer.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define MIXER_AVX2
+#include <immintrin.h>
+#endif
+
+typedef struct {
+    const int16_t *samples;
+    size_t frame_count;
+    size_t cursor;
+    // Frames of silence left before the sound starts
+    size_t delay;
+    float gain;
+    bool active;
+} Voice;
+
+static Voice voices[MIXER_VOICES] = {0};
+static size_t channels = 2;
+// The voices are summed as floats, so clipping only happens once at the end
+static float *acc = NULL;
+static size_t acc_capacity = 0;
+static bool warned_about_stealing = false;
+
+void mixer_reset(size_t new_channels)
+{
+    memset(voices, 0, sizeof(voices));
+    channels = new_channels;
+    warned_about_stealing = false;
+}
+
+void mixer_play(const int16_t *samples, size_t frame_count, float gain, size_t delay)
+{
+    if (frame_count == 0) return;
+
+    Voice *voice = NULL;
+    for (size_t i = 0; i < MIXER_VOICES && voice == NULL; ++i) {
+        if (!voices[i].active) voice = &voices[i];
+    }
+    if (voice == NULL) {
+        voice = &voices[0];
+        for (size_t i = 1; i < MIXER_VOICES; ++i) {
+            if (voices[i].cursor > voice->cursor) voice = &voices[i];
+        }
+        if (!warned_about_stealing) {
+            TraceLog(LOG_WARNING, "MIXER: all %d voices are busy, cutting off the oldest sound", MIXER_VOICES);
+            warned_about_stealing = true;
+        }
+    }
+
+    *voice = (Voice) {
+        .samples = samples,
+        .frame_count = frame_count,
+        .delay = delay,
+        .gain = gain,
+        .active = true,
+    };
+}
+
+static void accumulate_scalar(float *dst, const int16_t *src, size_t count, float gain)
+{
+    for (size_t i = 0; i < count; ++i) dst[i] += src[i]*gain;
+}
+
+static void store_scalar(int16_t *dst, const float *src, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        float x = src[i];
+        if (x > INT16_MAX) x = INT16_MAX;
+        if (x < INT16_MIN) x = INT16_MIN;
+        dst[i] = (int16_t)lrintf(x);
+    }
+}
+
+#ifdef MIXER_AVX2
+__attribute__((target("avx2")))
+static void accumulate_avx2(float *dst, const int16_t *src, size_t count, float gain)
+{
+    __m256 g = _mm256_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i s = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src + i)));
+        __m256 x = _mm256_mul_ps(_mm256_cvtepi32_ps(s), g);
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), x));
+    }
+    accumulate_scalar(dst + i, src + i, count - i, gain);
+}
+
+// Clamping before the conversion keeps cvtps from turning huge sums into
+// INT32_MIN, and packs saturates the rest of the way down to s16
+__attribute__((target("avx2")))
+static void store_avx2(int16_t *dst, const float *src, size_t count)
+{
+    const __m256 lo = _mm256_set1_ps(INT16_MIN);
+    const __m256 hi = _mm256_set1_ps(INT16_MAX);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), lo), hi);
+        __m256 b = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i + 8), lo), hi);
+        __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        // packs works within 128 bit lanes, this puts the halves back in order
+        packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i*)(dst + i), packed);
+    }
+    store_scalar(dst + i, src + i, count - i);
+}
+
+static bool has_avx2(void)
+{
+    static int cached = -1;
+    if (cached < 0) cached = __builtin_cpu_supports("avx2") ? 1 : 0;
+    return cached;
+}
+#endif // MIXER_AVX2
+
+static void accumulate(float *dst, const int16_t *src, size_t count, float gain)
+{
+#ifdef MIXER_AVX2
+    if (has_avx2()) {
+        accumulate_avx2(dst, src, count, gain);
+        return;
+    }
+#endif // MIXER_AVX2
+    accumulate_scalar(dst, src, count, gain);
+}
+
+static void store(int16_t *dst, const float *src, size_t count)
+{
+#ifdef MIXER_AVX2
+    if (has_avx2()) {
+        store_avx2(dst, src, count);
+        return;
+    }
+#endif // MIXER_AVX2
+    store_scalar(dst, src, count);
+}
+
+void mixer_mix(int16_t *out, size_t frame_count)
+{
+    size_t count = frame_count*channels;
+    if (acc_capacity < count) {
+        free(acc);
+        acc = malloc(sizeof(*acc)*count);
+        assert(acc != NULL && "Buy MORE RAM lol!!");
+        acc_capacity = count;
+    }
+    memset(acc, 0, sizeof(*acc)*count);
+
+    for (size_t i = 0; i < MIXER_VOICES; ++i) {
+        Voice *voice = &voices[i];
+        if (!voice->active) continue;
+
+        size_t start = voice->delay < frame_count ? voice->delay : frame_count;
+        voice->delay -= start;
+        size_t n = voice->frame_count - voice->cursor;
+        if (n > frame_count - start) n = frame_count - start;
+        accumulate(acc + start*channels, voice->samples + voice->cursor*channels, n*channels, voice->gain);
+        voice->cursor += n;
+        if (voice->cursor >= voice->frame_count) voice->active = false;
+    }
+
+    store(out, acc, count);
+}
+
+void mixer_skip(size_t frame_count)
+{
+    for (size_t i = 0; i < MIXER_VOICES; ++i) {
+        Voice *voice = &voices[i];
+        if (!voice->active) continue;
+
+        size_t start = voice->delay < frame_count ? voice->delay : frame_count;
+        voice->delay -= start;
+        voice->cursor += frame_count - start;
+        if (voice->cursor >= voice->frame_count) voice->active = false;
+    }
+}
+
+size_t mixer_active_voices(void)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < MIXER_VOICES; ++i) {
+        if (voices[i].active) count += 1;
+    }
+    return count;
+}
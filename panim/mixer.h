@@ -0,0 +1,29 @@
+#ifndef MIXER_H_
+#define MIXER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Software mixer for the rendered soundtrack, the counterpart of raylib's
+// mixer in the preview. Every play_sound() takes one of a fixed pool of
+// voices, and each frame of the sound is the sum of all the voices that are
+// playing, so overlapping sounds don't cut each other off. The samples are
+// interleaved s16 with the channel count given to mixer_reset().
+
+#define MIXER_VOICES 32
+
+// Stops all the voices
+void mixer_reset(size_t channels);
+// samples must stay alive until the voice is done with them. If all the
+// voices are busy the one that has been playing the longest is taken over.
+// The sound starts delay frames into the next mixer_mix(), which is how sounds
+// triggered in the middle of a video frame land on the exact sample.
+void mixer_play(const int16_t *samples, size_t frame_count, float gain, size_t delay);
+// Mixes the next frame_count frames of all the voices into out, clipping
+// whatever goes beyond what s16 can hold
+void mixer_mix(int16_t *out, size_t frame_count);
+// Advances all the voices without mixing anything
+void mixer_skip(size_t frame_count);
+size_t mixer_active_voices(void);
+
+#endif // MIXER_H_
@@ -6,46 +6,95 @@
 #include <raymath.h>
 
 #ifndef _WIN32
-//#include <dlfcn.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
 #endif
 
 #define NOB_IMPLEMENTATION
 #include "nob.h"
 #include "plug.h"
 #include "ffmpeg.h"
+#include "readback.h"
+#include "framehash.h"
+#include "trace.h"
+#include "imageseq.h"
+#include "mixer.h"
+#include "soundconv.h"
+#include "checkpoint.h"
 
-// #define FFMPEG_VIDEO_WIDTH 1600
-// #define FFMPEG_VIDEO_HEIGHT 900
-// #define FFMPEG_VIDEO_FPS 30
-#define FFMPEG_VIDEO_WIDTH 1920
-#define FFMPEG_VIDEO_HEIGHT 1080
-#define FFMPEG_VIDEO_FPS 60
-#define FFMPEG_VIDEO_DELTA_TIME (1.0f/FFMPEG_VIDEO_FPS)
-#define FFMPEG_SOUND_SAMPLE_RATE 44100
-#define FFMPEG_SOUND_CHANNELS 2
+// The resolution, framerate and sound format come from the render profile
 #define FFMPEG_SOUND_SAMPLE_SIZE_BITS 16
 #define FFMPEG_SOUND_SAMPLE_SIZE_BYTES (FFMPEG_SOUND_SAMPLE_SIZE_BITS/8)
-// SPF - Samples Per Frame
-#define FFMPEG_SOUND_SPF (FFMPEG_SOUND_SAMPLE_RATE/FFMPEG_VIDEO_FPS)
+// How many frames may be in flight between the GPU and ffmpeg
+#define READBACK_DEPTH 3
+#define PREVIEW_VIDEO_OUTPUT_PATH "output.mp4"
+#define BENCH_DEFAULT_FRAMES 600
 #define RENDERING_FONT_SIZE 78
 #define POPUP_DISAPPER_TIME 1.5f
+// How many steps of the fixed timestep a single preview frame may catch up on
+#define PREVIEW_MAX_CATCH_UP_STEPS 5
+// How often the preview saves the state of the animation for the scrubber
+#define PREVIEW_CHECKPOINT_SECONDS 1
+// Animations that don't finish by then are cut off on the scrubber
+#define PREVIEW_SCRUB_MAX_SECONDS (10*60)
+#define SCRUBBER_HEIGHT 10
+#define SCRUBBER_HOVER_HEIGHT 24
 
 // The state of Panim Engine
 static bool paused = false;
 static FFMPEG *ffmpeg_video = NULL;
 static FFMPEG *ffmpeg_audio = NULL;
+static Readback *readback = NULL;
+// When set the frames go into numbered images instead of ffmpeg_video
+static Image_Sequence *image_sequence = NULL;
+// Frames identical to the previous one (e.g. while the animation waits) are
+// recognized by their hash and do not get copied into ffmpeg again. The pixels
+// are compared as well when the hashes match, so a collision can't repeat the
+// wrong frame.
+static uint64_t last_frame_hash = 0;
+static bool has_last_frame = false;
+// Dump the timings of the render loop next to the video
+static bool trace_files = false;
+static bool image_sequence_requested = false;
+static Image_Sequence_Format image_sequence_format = IMAGE_SEQUENCE_QOI;
+static bool image_sequence_resume = false;
+static Render_Profile profile = {0};
+// SPF - Samples Per Frame
+static size_t sound_spf = 0;
 static RenderTexture2D screen = {0};
 static Font rendering_font = {0};
 static void *libplug = NULL;
-static Wave ffmpeg_wave = {0};
-static size_t ffmpeg_wave_cursor = 0;
-static uint8_t silence[FFMPEG_SOUND_SPF*FFMPEG_SOUND_SAMPLE_SIZE_BYTES*FFMPEG_SOUND_CHANNELS] = {0};
+// The sound of one frame, mixed from all the voices that are playing
+static int16_t *sound_frame = NULL;
 
 static float delta_time_multiplier = 1.0f;
 static float delta_time_multiplier_popup = 0.0f;
+// The preview advances the animation in the same 1/fps steps as the render
+static bool fixed_timestep = false;
+static double fixed_timestep_accumulator = 0.0;
+// How far the preview is into the animation
+static double preview_time = 0.0;
+// The length of the animation in frames of the render, 0 while it is not known.
+// Becomes stale when the plugin gets reloaded, because the new code may
+// animate differently.
+static size_t scrub_frames = 0;
+static bool scrub_stale = true;
+static bool scrub_dragging = false;
+typedef struct {
+    size_t *items;
+    size_t count;
+    size_t capacity;
+} Markers;
+// Frames marked with M, kept sorted
+static Markers markers = {0};
 
 #define PLUG(name, ret, ...) static ret (*name)(__VA_ARGS__);
 LIST_OF_PLUGS
+LIST_OF_OPTIONAL_PLUGS
 #undef PLUG
 
 #ifdef _WIN32
@@ -70,7 +119,10 @@ static bool reload_libplug(const char *libplug_path)
             return false; \
         }
     LIST_OF_PLUGS
+    #undef PLUG
 
+    #define PLUG(name, ret, ...) name = ( ret(*)(__VA_ARGS__) )GetProcAddress (libplug, #name);
+    LIST_OF_OPTIONAL_PLUGS
     #undef PLUG
 
     return true;
@@ -97,15 +149,93 @@ static bool reload_libplug(const char *libplug_path)
     LIST_OF_PLUGS
     #undef PLUG
 
+    #define PLUG(name, ...) name = dlsym(libplug, #name);
+    LIST_OF_OPTIONAL_PLUGS
+    #undef PLUG
+
     return true;
 }
 #endif
 
+// Everything that depends on the resolution, framerate or sound format of
+// the render has to be sized from here
+static void use_profile(Render_Profile new_profile)
+{
+    profile = new_profile;
+    sound_spf = profile.sample_rate/profile.fps;
+    if (profile.sample_rate%profile.fps != 0) {
+        TraceLog(LOG_WARNING, "PANIM: %zuhz is not a multiple of %zu fps, the sound will drift away from the picture",
+                 profile.sample_rate, profile.fps);
+    }
+    free(sound_frame);
+    sound_frame = calloc(sound_spf, FFMPEG_SOUND_SAMPLE_SIZE_BYTES*profile.channels);
+    assert(sound_frame != NULL && "Buy MORE RAM lol!!");
+    mixer_reset(profile.channels);
+}
+
+static void begin_video_frames(void)
+{
+    readback = readback_create(profile.width, profile.height, READBACK_DEPTH);
+    has_last_frame = false;
+    trace_reset();
+}
+
+static bool send_video_frame(void *pixels)
+{
+    double begin = trace_now();
+    size_t size = sizeof(uint32_t)*profile.width*profile.height;
+    uint64_t hash = frame_hash(pixels, size);
+    bool repeat = has_last_frame && hash == last_frame_hash;
+    if (repeat) {
+        const void *last = readback_previous(readback);
+        repeat = last != NULL && memcmp(last, pixels, size) == 0;
+    }
+    last_frame_hash = hash;
+    has_last_frame = true;
+    trace_span(TRACE_HASH, begin);
+
+    begin = trace_now();
+    bool ok;
+    if (image_sequence) {
+        ok = repeat ? image_sequence_repeat_frame(image_sequence)
+                    : image_sequence_send_frame_flipped(image_sequence, pixels, profile.width, profile.height);
+    } else {
+        ok = repeat ? ffmpeg_repeat_frame(ffmpeg_video)
+                    : ffmpeg_send_frame_flipped(ffmpeg_video, pixels, profile.width, profile.height);
+    }
+    trace_span(TRACE_SEND, begin);
+    return ok;
+}
+
+static bool flush_video_frames(void)
+{
+    for (;;) {
+        trace_frame_begin();
+        double begin = trace_now();
+        void *pixels = NULL;
+        bool ok = readback_pop(readback, &pixels);
+        trace_span(TRACE_READBACK, begin);
+        if (ok && pixels != NULL) ok = send_video_frame(pixels);
+        // The last pop only tells us there is nothing left
+        if (pixels != NULL) trace_frame_end();
+        if (!ok) {
+            readback_discard(readback);
+            return false;
+        }
+        if (pixels == NULL) return true;
+    }
+}
+
 static void finish_ffmpeg_video_rendering(bool cancel)
 {
     SetTraceLogLevel(LOG_INFO);
+    if (!cancel && !flush_video_frames()) cancel = true;
+    readback_destroy(readback);
+    readback = NULL;
     ffmpeg_end_rendering(ffmpeg_video, cancel);
+    trace_report(trace_files ? PREVIEW_VIDEO_OUTPUT_PATH : NULL);
     plug_reset();
+    preview_time = 0.0;
     paused = true;
     ffmpeg_video = NULL;
 }
@@ -115,39 +245,32 @@ static void finish_ffmpeg_audio_rendering(bool cancel)
     SetTraceLogLevel(LOG_INFO);
     ffmpeg_end_rendering(ffmpeg_audio, cancel);
     plug_reset();
+    preview_time = 0.0;
     paused = true;
     ffmpeg_audio = NULL;
 }
 
-void dummy_play_sound(Sound _sound, Wave _wave)
-{
-    (void)_sound;
-    (void)_wave;
-}
-
-void ffmpeg_play_sound(Sound _sound, Wave wave)
+void ffmpeg_play_sound(Sound sound, Wave wave, float offset)
 {
-    (void)_sound;
+    // Waves in another format get converted on their first play
+    size_t frame_count = 0;
+    const int16_t *samples = soundconv_get(sound, wave, profile.sample_rate, profile.channels, &frame_count);
+    if (samples == NULL) return;
 
-    if (
-        wave.sampleRate != FFMPEG_SOUND_SAMPLE_RATE      ||
-        wave.sampleSize != FFMPEG_SOUND_SAMPLE_SIZE_BITS ||
-        wave.channels   != FFMPEG_SOUND_CHANNELS
-    ) {
-        TraceLog(LOG_ERROR,
-                 "Animation tried to play sound with rate: %dhz, sample size: %d bits, channels: %d. "
-                 "But we only support rate: %dhz, sample size: %d bits, channels: %d for now",
-                 wave.sampleRate, wave.sampleSize, wave.channels);
-        return;
-    }
-
-    ffmpeg_wave = wave;
-    ffmpeg_wave_cursor = 0;
+    // The sound of the frame that is being updated is mixed right after the
+    // update, so the offset maps straight onto its samples
+    size_t delay = 0;
+    if (offset > 0.0f) delay = (size_t)(offset*sound_spf);
+    if (delay >= sound_spf) delay = sound_spf - 1;
+    mixer_play(samples, frame_count, 1.0f, delay);
 }
 
-void preview_play_sound(Sound sound, Wave _wave)
+// raylib starts playing on its own audio thread, so there is nothing to align
+// the offset with
+void preview_play_sound(Sound sound, Wave _wave, float _offset)
 {
     (void)_wave;
+    (void)_offset;
     PlaySound(sound);
 }
 
@@ -194,20 +317,868 @@ void rendering_scene(const char *text)
     }
 }
 
+static void reset_ffmpeg_sound(void)
+{
+    mixer_reset(profile.channels);
+}
+
+// Sends the next sound_spf samples of all the sounds that are currently
+// playing, which is silence when there are none
+static bool send_sound_frame(FFMPEG *ffmpeg)
+{
+    mixer_mix(sound_frame, sound_spf);
+    return ffmpeg_send_sound_samples(ffmpeg, sound_frame, sound_spf*FFMPEG_SOUND_SAMPLE_SIZE_BYTES*profile.channels);
+}
+
+static bool render_audio_frame(void)
+{
+    BeginTextureMode(screen);
+    plug_update(CLITERAL(Env) {
+        .screen_width = profile.width,
+        .screen_height = profile.height,
+        .delta_time = 1.0f/profile.fps,
+        .rendering = true,
+        .play_sound = ffmpeg_play_sound,
+    });
+    EndTextureMode();
+
+    return send_sound_frame(ffmpeg_audio);
+}
+
+// Renders the next frame of both the picture and the sound into ffmpeg_video,
+// or only the picture into image_sequence
+static bool render_video_frame(void)
+{
+    trace_frame_begin();
+
+    double begin = trace_now();
+    BeginTextureMode(screen);
+    plug_update(CLITERAL(Env) {
+        .screen_width = profile.width,
+        .screen_height = profile.height,
+        .delta_time = 1.0f/profile.fps,
+        .rendering = true,
+        .play_sound = ffmpeg_play_sound,
+    });
+    trace_span(TRACE_UPDATE, begin);
+
+    begin = trace_now();
+    EndTextureMode();
+    trace_span(TRACE_END_TEXTURE, begin);
+
+    // The sound goes out right away while the picture lags behind in the
+    // readback ring, so ffmpeg never ends up waiting for audio it needs to
+    // interleave with the video it already has
+    bool ok = true;
+    if (ffmpeg_video) {
+        begin = trace_now();
+        ok = send_sound_frame(ffmpeg_video);
+        trace_span(TRACE_SOUND, begin);
+    }
+
+    if (ok) {
+        // The pixels we get back belong to a frame drawn READBACK_DEPTH - 1 frames ago
+        begin = trace_now();
+        void *pixels = NULL;
+        ok = readback_push(readback, screen, &pixels);
+        trace_span(TRACE_READBACK, begin);
+        if (ok && pixels != NULL) ok = send_video_frame(pixels);
+    }
+
+    trace_frame_end();
+    return ok;
+}
+
+// Advances the animation by one frame without drawing it or sending anything to ffmpeg
+static void skip_frame(void)
+{
+    plug_update(CLITERAL(Env) {
+        .screen_width = profile.width,
+        .screen_height = profile.height,
+        .delta_time = 1.0f/profile.fps,
+        .rendering = true,
+        .simulating = true,
+        .play_sound = ffmpeg_play_sound,
+    });
+
+    mixer_skip(sound_spf);
+}
+
+// The window is hidden and nothing is ever presented, so there is no frame cap
+// and no vsync: the frames are produced as fast as the plugin and ffmpeg can go.
+static bool init_headless(void)
+{
+    SetConfigFlags(FLAG_WINDOW_HIDDEN);
+    InitWindow(profile.width, profile.height, "Panim");
+    if (!IsWindowReady()) {
+        TraceLog(LOG_ERROR, "PANIM: could not create an OpenGL context for rendering");
+        return false;
+    }
+    InitAudioDevice();
+    SetTraceLogLevel(LOG_WARNING);
+    plug_init();
+
+    screen = LoadRenderTexture(profile.width, profile.height);
+    return true;
+}
+
+static void deinit_headless(void)
+{
+    UnloadRenderTexture(screen);
+    CloseWindow();
+}
+
+// Renders frames [begin, end) of the animation into output_path, stopping
+// early if the animation finishes. Segments keep the sound uncompressed so
+// they can be concatenated later without re-encoding.
+static bool render_frames(const char *output_path, size_t begin, size_t end, bool segment)
+{
+    reset_ffmpeg_sound();
+    plug_reset();
+    for (size_t i = 0; i < begin && !plug_finished(); ++i) {
+        skip_frame();
+    }
+
+    if (segment) {
+        ffmpeg_video = ffmpeg_start_rendering_segment(output_path, &profile);
+    } else {
+        ffmpeg_video = ffmpeg_start_rendering_video_with_audio(output_path, &profile);
+    }
+    if (ffmpeg_video == NULL) return false;
+    begin_video_frames();
+
+    bool ok = true;
+    size_t frames = 0;
+    double start = GetTime();
+    for (size_t i = begin; i < end && !plug_finished(); ++i) {
+        if (!render_video_frame()) {
+            ok = false;
+            break;
+        }
+        frames += 1;
+    }
+    if (ok && !flush_video_frames()) ok = false;
+    double elapsed = GetTime() - start;
+
+    readback_destroy(readback);
+    readback = NULL;
+
+    SetTraceLogLevel(LOG_INFO);
+    if (!ffmpeg_end_rendering(ffmpeg_video, !ok)) ok = false;
+    ffmpeg_video = NULL;
+    trace_report(trace_files ? output_path : NULL);
+
+    if (ok) {
+        TraceLog(LOG_INFO, "PANIM: rendered %zu frames into %s in %.2fs (%.2f fps)",
+                 frames, output_path, elapsed, elapsed > 0 ? frames/elapsed : 0.0);
+    }
+    SetTraceLogLevel(LOG_WARNING);
+
+    return ok;
+}
+
+// Renders the animation into numbered images in output_dir. With resume the
+// frames that the manifest of output_dir already has are only simulated.
+static bool render_image_sequence(const char *output_dir, Image_Sequence_Format format, bool resume)
+{
+    size_t begin = resume ? image_sequence_resume_point(output_dir) : 0;
+    reset_ffmpeg_sound();
+    plug_reset();
+    for (size_t i = 0; i < begin && !plug_finished(); ++i) {
+        skip_frame();
+    }
+    if (begin > 0) TraceLog(LOG_INFO, "PANIM: resuming %s from frame %zu", output_dir, begin);
+
+    image_sequence = image_sequence_start(output_dir, &profile, format, begin);
+    if (image_sequence == NULL) return false;
+    begin_video_frames();
+
+    bool ok = true;
+    size_t frames = 0;
+    double start = GetTime();
+    while (!plug_finished()) {
+        if (!render_video_frame()) {
+            ok = false;
+            break;
+        }
+        frames += 1;
+    }
+    if (ok && !flush_video_frames()) ok = false;
+
+    readback_destroy(readback);
+    readback = NULL;
+
+    SetTraceLogLevel(LOG_INFO);
+    if (!image_sequence_end(image_sequence, !ok)) ok = false;
+    image_sequence = NULL;
+    double elapsed = GetTime() - start;
+    trace_report(trace_files ? output_dir : NULL);
+
+    if (ok) {
+        TraceLog(LOG_INFO, "PANIM: rendered %zu frames into %s in %.2fs (%.2f fps)",
+                 frames, output_dir, elapsed, elapsed > 0 ? frames/elapsed : 0.0);
+    }
+    SetTraceLogLevel(LOG_WARNING);
+
+    return ok;
+}
+
+#ifndef _WIN32
+// GetTime() needs a window, which the parent of the workers never opens
+static double monotonic_secs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// Runs the animation to the end in a child process to find out how many frames it has.
+// Every process needs its own OpenGL context, so the parent never creates one.
+static bool count_frames_in_child(size_t *frames)
+{
+    int pipefd[2];
+    if (pipe(pipefd) < 0) {
+        TraceLog(LOG_ERROR, "PANIM: could not create a pipe: %s", strerror(errno));
+        return false;
+    }
+
+    pid_t child = fork();
+    if (child < 0) {
+        TraceLog(LOG_ERROR, "PANIM: could not fork a child: %s", strerror(errno));
+        close(pipefd[0]);
+        close(pipefd[1]);
+        return false;
+    }
+
+    if (child == 0) {
+        close(pipefd[0]);
+        if (!init_headless()) exit(1);
+        size_t count = 0;
+        reset_ffmpeg_sound();
+        plug_reset();
+        while (!plug_finished()) {
+            skip_frame();
+            count += 1;
+        }
+        deinit_headless();
+        exit(write(pipefd[1], &count, sizeof(count)) == sizeof(count) ? 0 : 1);
+    }
+
+    close(pipefd[1]);
+    bool ok = read(pipefd[0], frames, sizeof(*frames)) == sizeof(*frames);
+    close(pipefd[0]);
+
+    int wstatus = 0;
+    if (waitpid(child, &wstatus, 0) < 0 || !WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) ok = false;
+    if (!ok) TraceLog(LOG_ERROR, "PANIM: could not count the frames of the animation");
+    return ok;
+}
+
+// Splits the timeline into jobs segments, renders each one in its own worker
+// process and joins the results. Every worker simulates the animation up to
+// the beginning of its segment without drawing it.
+static bool render_parallel(const char *output_path, size_t jobs)
+{
+    size_t frames = 0;
+    if (!count_frames_in_child(&frames)) return false;
+    if (frames == 0) {
+        TraceLog(LOG_ERROR, "PANIM: the animation has no frames to render");
+        return false;
+    }
+    if (jobs > frames) jobs = frames;
+
+    double start = monotonic_secs();
+    const char **segment_paths = malloc(sizeof(*segment_paths)*jobs);
+    pid_t *workers = malloc(sizeof(*workers)*jobs);
+    assert(segment_paths != NULL && workers != NULL && "Buy MORE RAM lol!!");
+
+    bool ok = true;
+    size_t spawned = 0;
+    for (size_t k = 0; k < jobs; ++k) {
+        segment_paths[k] = nob_temp_sprintf("%s.part%zu.mkv", output_path, k);
+        size_t begin = frames*k/jobs;
+        size_t end = frames*(k + 1)/jobs;
+
+        pid_t child = fork();
+        if (child < 0) {
+            TraceLog(LOG_ERROR, "PANIM: could not fork a worker: %s", strerror(errno));
+            ok = false;
+            break;
+        }
+        if (child == 0) {
+            if (!init_headless()) exit(1);
+            bool worker_ok = render_frames(segment_paths[k], begin, end, true);
+            deinit_headless();
+            exit(worker_ok ? 0 : 1);
+        }
+        workers[k] = child;
+        spawned += 1;
+    }
+
+    for (size_t k = 0; k < spawned; ++k) {
+        int wstatus = 0;
+        if (waitpid(workers[k], &wstatus, 0) < 0 || !WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) {
+            TraceLog(LOG_ERROR, "PANIM: worker %zu failed to render %s", k, segment_paths[k]);
+            ok = false;
+        }
+    }
+
+    if (ok) ok = ffmpeg_concat_segments(output_path, segment_paths, jobs, &profile);
+
+    for (size_t k = 0; k < spawned; ++k) {
+        if (unlink(segment_paths[k]) < 0 && errno != ENOENT) {
+            TraceLog(LOG_WARNING, "PANIM: could not remove %s: %s", segment_paths[k], strerror(errno));
+        }
+    }
+
+    if (ok) {
+        double elapsed = monotonic_secs() - start;
+        SetTraceLogLevel(LOG_INFO);
+        TraceLog(LOG_INFO, "PANIM: rendered %zu frames into %s with %zu workers in %.2fs (%.2f fps)",
+                 frames, output_path, jobs, elapsed, elapsed > 0 ? frames/elapsed : 0.0);
+    }
+
+    free(workers);
+    free(segment_paths);
+    return ok;
+}
+#endif // _WIN32
+
+// Renders the whole animation into output_path without the preview loop
+static bool render_headless(const char *output_path, size_t jobs)
+{
+    if (image_sequence_requested) {
+        if (!init_headless()) return false;
+        bool ok = render_image_sequence(output_path, image_sequence_format, image_sequence_resume);
+        deinit_headless();
+        return ok;
+    }
+
+    if (jobs > 1) {
+#ifndef _WIN32
+        return render_parallel(output_path, jobs);
+#else
+        TraceLog(LOG_ERROR, "PANIM: parallel rendering is not supported on Windows yet");
+        return false;
+#endif // _WIN32
+    }
+
+    if (!init_headless()) return false;
+    bool ok = render_frames(output_path, 0, SIZE_MAX, false);
+    deinit_headless();
+    return ok;
+}
+
+// The most voices that played at once, out of MIXER_VOICES
+static size_t bench_peak_voices = 0;
+
+// Same as render_video_frame() minus ffmpeg, so the animation, raylib, the
+// sound mixer and the GPU readback get measured but not the encoding
+static bool bench_frame(void)
+{
+    if (plug_finished()) plug_reset();
+
+    trace_frame_begin();
+
+    double begin = trace_now();
+    BeginTextureMode(screen);
+    plug_update(CLITERAL(Env) {
+        .screen_width = profile.width,
+        .screen_height = profile.height,
+        .delta_time = 1.0f/profile.fps,
+        .rendering = true,
+        .play_sound = ffmpeg_play_sound,
+    });
+    trace_span(TRACE_UPDATE, begin);
+
+    begin = trace_now();
+    EndTextureMode();
+    trace_span(TRACE_END_TEXTURE, begin);
+
+    // The sound gets mixed like in the render, it just doesn't go anywhere
+    begin = trace_now();
+    size_t voices = mixer_active_voices();
+    if (voices > bench_peak_voices) bench_peak_voices = voices;
+    mixer_mix(sound_frame, sound_spf);
+    trace_span(TRACE_SOUND, begin);
+
+    begin = trace_now();
+    void *pixels = NULL;
+    bool ok = readback_push(readback, screen, &pixels);
+    trace_span(TRACE_READBACK, begin);
+    if (ok && pixels != NULL) {
+        begin = trace_now();
+        frame_hash(pixels, sizeof(uint32_t)*profile.width*profile.height);
+        trace_span(TRACE_HASH, begin);
+    }
+
+    trace_frame_end();
+    return ok;
+}
+
+static void sb_append_json_string(Nob_String_Builder *sb, const char *cstr)
+{
+    nob_sb_append_cstr(sb, "\"");
+    for (const char *c = cstr; *c != '\0'; ++c) {
+        if (*c == '"' || *c == '\\') nob_da_append(sb, '\\');
+        nob_da_append(sb, *c);
+    }
+    nob_sb_append_cstr(sb, "\"");
+}
+
+static size_t peak_rss_kb(void)
+{
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) < 0) return 0;
+    return usage.ru_maxrss;
+#else
+    return 0;
+#endif // _WIN32
+}
+
+// Runs frame_count frames of the animation headless, starting it over
+// whenever it finishes, and writes the throughput into result_path as JSON
+static bool bench_headless(const char *libplug_path, const char *result_path, size_t frame_count)
+{
+    if (!init_headless()) return false;
+
+    reset_ffmpeg_sound();
+    plug_reset();
+    begin_video_frames();
+    bench_peak_voices = 0;
+    double start = GetTime();
+    bool ok = true;
+    for (size_t i = 0; ok && i < frame_count; ++i) {
+        ok = bench_frame();
+    }
+    double elapsed = GetTime() - start;
+    readback_destroy(readback);
+    readback = NULL;
+    if (!ok) {
+        TraceLog(LOG_ERROR, "PANIM: could not read back the frames of the benchmark");
+        deinit_headless();
+        return false;
+    }
+
+    SetTraceLogLevel(LOG_INFO);
+    trace_report(trace_files ? result_path : NULL);
+
+    Nob_String_Builder sb = {0};
+    nob_sb_append_cstr(&sb, "{\"plugin\": ");
+    sb_append_json_string(&sb, libplug_path);
+    nob_sb_append_cstr(&sb, ", \"profile\": ");
+    sb_append_json_string(&sb, profile.name);
+    nob_sb_append_cstr(&sb, nob_temp_sprintf(", \"width\": %zu, \"height\": %zu, ", profile.width, profile.height));
+    nob_sb_append_cstr(&sb, nob_temp_sprintf("\"frames\": %zu, \"seconds\": %.6f, \"fps\": %.3f, ",
+                                             frame_count, elapsed, elapsed > 0 ? frame_count/elapsed : 0.0));
+    nob_sb_append_cstr(&sb, nob_temp_sprintf("\"frame_ms\": {\"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f}, ",
+                                             trace_frame_percentile(50)*1000.0,
+                                             trace_frame_percentile(95)*1000.0,
+                                             trace_frame_percentile(99)*1000.0,
+                                             trace_frame_percentile(100)*1000.0));
+    nob_sb_append_cstr(&sb, nob_temp_sprintf("\"peak_voices\": %zu, \"peak_rss_kb\": %zu}\n", bench_peak_voices, peak_rss_kb()));
+    ok = nob_write_entire_file(result_path, sb.items, sb.count);
+    if (ok) TraceLog(LOG_INFO, "PANIM: %zu frames in %.2fs (%.2f fps), results in %s",
+                     frame_count, elapsed, elapsed > 0 ? frame_count/elapsed : 0.0, result_path);
+    nob_sb_free(sb);
+
+    deinit_headless();
+    return ok;
+}
+
+// Advances and draws the animation in the preview. With the fixed timestep
+// the plugin only ever sees the delta_time of the render, so the preview plays
+// exactly what the render will produce. Only the last step of a frame is
+// drawn, and a frame that falls between two steps redraws the last one
+// without advancing.
+static void preview_update(void)
+{
+    Env env = {
+        .screen_width = GetScreenWidth(),
+        .screen_height = GetScreenHeight(),
+        .rendering = false,
+        .play_sound = preview_play_sound,
+    };
+
+    if (!fixed_timestep) {
+        env.delta_time = paused ? 0.0 : GetFrameTime()*delta_time_multiplier;
+        plug_update(env);
+        preview_time += env.delta_time;
+        return;
+    }
+
+    double step = 1.0/profile.fps;
+    if (!paused) fixed_timestep_accumulator += GetFrameTime()*delta_time_multiplier;
+    size_t steps = fixed_timestep_accumulator/step;
+    if (steps > PREVIEW_MAX_CATCH_UP_STEPS) {
+        // After a hitch the preview falls behind instead of freezing on a
+        // burst of steps that only makes the next frame slower
+        steps = PREVIEW_MAX_CATCH_UP_STEPS;
+        fixed_timestep_accumulator = steps*step;
+    }
+    fixed_timestep_accumulator -= steps*step;
+
+    for (size_t i = 1; i < steps; ++i) {
+        Env simulated = env;
+        simulated.delta_time = step;
+        simulated.simulating = true;
+        plug_update(simulated);
+    }
+    env.delta_time = steps > 0 ? step : 0.0;
+    plug_update(env);
+    preview_time += steps*step;
+}
+
+static void silent_play_sound(Sound _sound, Wave _wave, float _offset)
+{
+    (void)_sound;
+    (void)_wave;
+    (void)_offset;
+}
+
+// Advances the preview by one frame of the render without drawing it or
+// playing any sounds
+static void preview_simulate_frame(void)
+{
+    plug_update(CLITERAL(Env) {
+        .screen_width = GetScreenWidth(),
+        .screen_height = GetScreenHeight(),
+        .delta_time = 1.0f/profile.fps,
+        .simulating = true,
+        .play_sound = silent_play_sound,
+    });
+}
+
+// The frame of the render the preview is at
+static size_t preview_frame(void)
+{
+    // The steps don't add up to exact multiples of 1/fps
+    return preview_time*profile.fps + 1e-3;
+}
+
+static void preview_save_checkpoint(size_t frame)
+{
+    if (plug_save == NULL) return;
+    size_t size = plug_save(NULL, 0);
+    if (size == 0) return;
+    void *data = checkpoints_push(frame, size);
+    size_t saved = plug_save(data, size);
+    assert(saved == size && "plug_save() changed its mind about the size of the state");
+}
+
+static void preview_jump(size_t frame);
+
+// Plays the whole animation without drawing it to find out how long it is,
+// saving a checkpoint every PREVIEW_CHECKPOINT_SECONDS on the way. That takes
+// a while for long animations, so it only happens once the scrubber is used.
+// Leaves the animation at the frame it was at.
+static void preview_index(void)
+{
+    size_t frame = preview_frame();
+    double start = GetTime();
+    size_t interval = PREVIEW_CHECKPOINT_SECONDS*profile.fps;
+    size_t max_frames = PREVIEW_SCRUB_MAX_SECONDS*profile.fps;
+
+    checkpoints_clear();
+    plug_reset();
+    scrub_frames = 0;
+    while (!plug_finished() && scrub_frames < max_frames) {
+        if (scrub_frames%interval == 0) preview_save_checkpoint(scrub_frames);
+        preview_simulate_frame();
+        scrub_frames += 1;
+    }
+    scrub_stale = false;
+
+    if (scrub_frames >= max_frames) {
+        TraceLog(LOG_WARNING, "PANIM: the animation did not finish in %d seconds, the scrubber only covers those", PREVIEW_SCRUB_MAX_SECONDS);
+    }
+    TraceLog(LOG_INFO, "PANIM: indexed %zu frames in %.2fs, %zu checkpoints take %zu KB",
+             scrub_frames, GetTime() - start, checkpoints_count(), checkpoints_bytes()/1024);
+    if (checkpoints_count() == 0) {
+        TraceLog(LOG_INFO, "PANIM: the plugin can't save its state, so every jump simulates the animation from the beginning");
+    }
+    preview_jump(frame);
+}
+
+// Puts the preview at the beginning of frame. The animation is restored from
+// the nearest checkpoint before it and simulated from there.
+static void preview_jump(size_t frame)
+{
+    if (frame > scrub_frames) frame = scrub_frames;
+
+    size_t current = 0;
+    const Checkpoint *checkpoint = plug_load != NULL ? checkpoints_find(frame) : NULL;
+    if (checkpoint != NULL) {
+        plug_load(checkpoint->data, checkpoint->size);
+        current = checkpoint->frame;
+    } else {
+        plug_reset();
+    }
+    for (; current < frame && !plug_finished(); ++current) {
+        preview_simulate_frame();
+    }
+
+    preview_time = (double)frame/profile.fps;
+    fixed_timestep_accumulator = 0.0;
+}
+
+static void toggle_marker(size_t frame)
+{
+    size_t i = 0;
+    while (i < markers.count && markers.items[i] < frame) i += 1;
+    if (i < markers.count && markers.items[i] == frame) {
+        memmove(markers.items + i, markers.items + i + 1, sizeof(*markers.items)*(markers.count - i - 1));
+        markers.count -= 1;
+        return;
+    }
+    nob_da_append(&markers, frame);
+    memmove(markers.items + i + 1, markers.items + i, sizeof(*markers.items)*(markers.count - i - 1));
+    markers.items[i] = frame;
+}
+
+// The beginning and the end of the animation count as markers too
+static size_t previous_marker(size_t frame)
+{
+    size_t result = 0;
+    for (size_t i = 0; i < markers.count && markers.items[i] < frame; ++i) result = markers.items[i];
+    return result;
+}
+
+static size_t next_marker(size_t frame)
+{
+    for (size_t i = 0; i < markers.count; ++i) {
+        if (markers.items[i] > frame) return markers.items[i];
+    }
+    return scrub_frames;
+}
+
+static Rectangle scrubber_bar(bool expanded)
+{
+    float height = expanded ? SCRUBBER_HOVER_HEIGHT : SCRUBBER_HEIGHT;
+    return (Rectangle) {0, GetScreenHeight() - height, GetScreenWidth(), height};
+}
+
+// Every jump has to know how long the animation is
+static void scrubber_index(void)
+{
+    if (scrub_stale) preview_index();
+}
+
+// Has to happen before preview_update(), so a jump shows up in the same frame
+static void scrubber_input(void)
+{
+    if (IsKeyPressed(KEY_LEFT) || IsKeyPressedRepeat(KEY_LEFT)) {
+        paused = true;
+        scrubber_index();
+        size_t frame = preview_frame();
+        preview_jump(frame > 0 ? frame - 1 : 0);
+    }
+    if (IsKeyPressed(KEY_RIGHT) || IsKeyPressedRepeat(KEY_RIGHT)) {
+        paused = true;
+        scrubber_index();
+        preview_jump(preview_frame() + 1);
+    }
+    if (IsKeyPressed(KEY_LEFT_BRACKET)) {
+        scrubber_index();
+        preview_jump(previous_marker(preview_frame()));
+    }
+    if (IsKeyPressed(KEY_RIGHT_BRACKET)) {
+        scrubber_index();
+        preview_jump(next_marker(preview_frame()));
+    }
+    if (IsKeyPressed(KEY_M)) toggle_marker(preview_frame());
+
+    if (scrub_frames == 0 && !scrub_stale) return;
+    Vector2 mouse = GetMousePosition();
+    if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT) && CheckCollisionPointRec(mouse, scrubber_bar(true))) {
+        scrubber_index();
+        scrub_dragging = scrub_frames > 0;
+    }
+    if (!IsMouseButtonDown(MOUSE_BUTTON_LEFT)) scrub_dragging = false;
+    if (scrub_dragging) {
+        float t = Clamp(mouse.x/GetScreenWidth(), 0.0f, 1.0f);
+        size_t frame = roundf(t*scrub_frames);
+        if (frame != preview_frame()) preview_jump(frame);
+    }
+}
+
+static void scrubber_draw(void)
+{
+    if (scrub_frames == 0 && !scrub_stale) return;
+    bool expanded = scrub_dragging || CheckCollisionPointRec(GetMousePosition(), scrubber_bar(true));
+    Rectangle bar = scrubber_bar(expanded);
+    DrawRectangleRec(bar, ColorAlpha(BLACK, 0.6f));
+
+    // Nothing is known about the animation before the scrubber is first used
+    if (scrub_frames == 0) {
+        if (expanded) DrawText(TextFormat("%zu / ?", preview_frame()), 10, bar.y - 30, 20, WHITE);
+        return;
+    }
+
+    float progress = Clamp(preview_time*profile.fps/scrub_frames, 0.0f, 1.0f);
+    DrawRectangleRec(CLITERAL(Rectangle) {bar.x, bar.y, bar.width*progress, bar.height}, ColorAlpha(WHITE, 0.8f));
+    for (size_t i = 0; i < markers.count; ++i) {
+        float x = bar.width*markers.items[i]/scrub_frames;
+        DrawRectangleRec(CLITERAL(Rectangle) {x - 1, bar.y, 2, bar.height}, YELLOW);
+    }
+
+    if (expanded) {
+        const char *text = TextFormat("%zu / %zu", preview_frame(), scrub_frames);
+        DrawText(text, 10, bar.y - 30, 20, WHITE);
+    }
+}
+
+static void usage(const char *program_name)
+{
+    fprintf(stderr, "Usage: %s [--render <output.mp4>] [--jobs <count>] [--profile <name|file>] [--yuv] [--libav] [--image-sequence <qoi|png>] [--resume] [--trace] [--bench <result.json>] [--bench-frames <count>] [--fixed-timestep] <libplug.so>\n", program_name);
+    fprintf(stderr, "    --render <output.mp4>    render the animation headless into the file and exit\n");
+    fprintf(stderr, "    --jobs <count>           split the render between that many worker processes\n");
+    fprintf(stderr, "    --profile <name|file>    render with one of the built-in profiles or the one in the file:\n");
+    profile_print_builtins();
+    fprintf(stderr, "    --yuv                    convert the frames to yuv420p ourselves instead of in ffmpeg\n");
+    fprintf(stderr, "    --libav                  encode in-process with libavcodec of FFmpeg 6 or 7 when it is installed\n");
+    fprintf(stderr, "    --image-sequence <qoi|png> render into numbered images in the --render directory instead of a video\n");
+    fprintf(stderr, "    --resume                 continue the image sequence from the last frame in its manifest\n");
+    fprintf(stderr, "    --trace                  write the timings of the render loop into <output>.trace.json and <output>.frames.csv\n");
+    fprintf(stderr, "    --bench <result.json>    measure how fast the animation renders headless (without ffmpeg) and exit\n");
+    fprintf(stderr, "    --bench-frames <count>   how many frames to measure, %d by default\n", BENCH_DEFAULT_FRAMES);
+    fprintf(stderr, "    --fixed-timestep         advance the preview in the same steps as the render (toggled with F)\n");
+}
+
 int main(int argc, char **argv)
 {
     const char *program_name = nob_shift_args(&argc, &argv);
 
+    const char *render_output_path = NULL;
+    const char *bench_result_path = NULL;
+    size_t bench_frames = BENCH_DEFAULT_FRAMES;
+    size_t render_jobs = 1;
+    Render_Profile render_profile = profile_default();
+    bool convert_yuv = false;
+    while (argc > 0 && strncmp(argv[0], "--", 2) == 0) {
+        const char *flag = nob_shift_args(&argc, &argv);
+        if (strcmp(flag, "--render") == 0) {
+            if (argc <= 0) {
+                usage(program_name);
+                fprintf(stderr, "ERROR: no value is provided for %s\n", flag);
+                return 1;
+            }
+            render_output_path = nob_shift_args(&argc, &argv);
+        } else if (strcmp(flag, "--jobs") == 0) {
+            if (argc <= 0) {
+                usage(program_name);
+                fprintf(stderr, "ERROR: no value is provided for %s\n", flag);
+                return 1;
+            }
+            const char *value = nob_shift_args(&argc, &argv);
+            char *endptr = NULL;
+            long jobs = strtol(value, &endptr, 10);
+            if (*value == '\0' || *endptr != '\0' || jobs <= 0) {
+                usage(program_name);
+                fprintf(stderr, "ERROR: %s is not a valid amount of jobs\n", value);
+                return 1;
+            }
+            render_jobs = jobs;
+        } else if (strcmp(flag, "--bench") == 0) {
+            if (argc <= 0) {
+                usage(program_name);
+                fprintf(stderr, "ERROR: no value is provided for %s\n", flag);
+                return 1;
+            }
+            bench_result_path = nob_shift_args(&argc, &argv);
+        } else if (strcmp(flag, "--bench-frames") == 0) {
+            if (argc <= 0) {
+                usage(program_name);
+                fprintf(stderr, "ERROR: no value is provided for %s\n", flag);
+                return 1;
+            }
+            const char *value = nob_shift_args(&argc, &argv);
+            char *endptr = NULL;
+            long frames = strtol(value, &endptr, 10);
+            if (*value == '\0' || *endptr != '\0' || frames <= 0) {
+                usage(program_name);
+                fprintf(stderr, "ERROR: %s is not a valid amount of frames\n", value);
+                return 1;
+            }
+            bench_frames = frames;
+        } else if (strcmp(flag, "--profile") == 0) {
+            if (argc <= 0) {
+                usage(program_name);
+                fprintf(stderr, "ERROR: no value is provided for %s\n", flag);
+                return 1;
+            }
+            const char *name = nob_shift_args(&argc, &argv);
+            if (!profile_load(name, &render_profile)) {
+                fprintf(stderr, "ERROR: could not load render profile %s\n", name);
+                return 1;
+            }
+        } else if (strcmp(flag, "--yuv") == 0) {
+            convert_yuv = true;
+        } else if (strcmp(flag, "--libav") == 0) {
+            ffmpeg_use_libav(true);
+        } else if (strcmp(flag, "--image-sequence") == 0) {
+#ifdef _WIN32
+            fprintf(stderr, "ERROR: %s is not supported on Windows yet\n", flag);
+            return 1;
+#endif // _WIN32
+            if (argc <= 0) {
+                usage(program_name);
+                fprintf(stderr, "ERROR: no value is provided for %s\n", flag);
+                return 1;
+            }
+            const char *value = nob_shift_args(&argc, &argv);
+            if (!image_sequence_parse_format(value, &image_sequence_format)) {
+                usage(program_name);
+                fprintf(stderr, "ERROR: %s is not a valid image format\n", value);
+                return 1;
+            }
+            image_sequence_requested = true;
+        } else if (strcmp(flag, "--resume") == 0) {
+            image_sequence_resume = true;
+        } else if (strcmp(flag, "--trace") == 0) {
+            trace_files = true;
+        } else if (strcmp(flag, "--fixed-timestep") == 0) {
+            fixed_timestep = true;
+        } else {
+            usage(program_name);
+            fprintf(stderr, "ERROR: unknown flag %s\n", flag);
+            return 1;
+        }
+    }
+
     if (argc <= 0) {
-        fprintf(stderr, "Usage: %s <libplug.so>\n", program_name);
+        usage(program_name);
         fprintf(stderr, "ERROR: no animation dynamic library is provided\n");
         return 1;
     }
 
     const char *libplug_path = nob_shift_args(&argc, &argv);
 
+    if (image_sequence_requested && render_output_path == NULL) {
+        usage(program_name);
+        fprintf(stderr, "ERROR: --image-sequence needs the output directory from --render\n");
+        return 1;
+    }
+    if (image_sequence_requested && render_jobs > 1) {
+        usage(program_name);
+        fprintf(stderr, "ERROR: --image-sequence can't be split between --jobs yet\n");
+        return 1;
+    }
+    if (image_sequence_resume && !image_sequence_requested) {
+        usage(program_name);
+        fprintf(stderr, "ERROR: --resume only works with --image-sequence\n");
+        return 1;
+    }
+
+    if (convert_yuv) render_profile.yuv420p = true;
+    use_profile(render_profile);
+
     if (!reload_libplug(libplug_path)) return 1;
 
+    if (bench_result_path) return bench_headless(libplug_path, bench_result_path, bench_frames) ? 0 : 1;
+    if (render_output_path) return render_headless(render_output_path, render_jobs) ? 0 : 1;
+
     float factor = 100.0f;
     SetConfigFlags(FLAG_MSAA_4X_HINT | FLAG_WINDOW_RESIZABLE);
     InitWindow(16*factor, 9*factor, "Panim");
@@ -216,7 +1187,7 @@ int main(int argc, char **argv)
     SetExitKey(KEY_NULL);
     plug_init();
 
-    screen = LoadRenderTexture(FFMPEG_VIDEO_WIDTH, FFMPEG_VIDEO_HEIGHT);
+    screen = LoadRenderTexture(profile.width, profile.height);
     rendering_font = LoadFontEx("./assets/fonts/Vollkorn-Regular.ttf", RENDERING_FONT_SIZE, NULL, 0);
 
     while (!WindowShouldClose()) {
@@ -226,22 +1197,8 @@ int main(int argc, char **argv)
                     finish_ffmpeg_video_rendering(false);
                 } else if (IsKeyPressed(KEY_ESCAPE)) {
                     finish_ffmpeg_video_rendering(true);
-                } else {
-                    BeginTextureMode(screen);
-                    plug_update(CLITERAL(Env) {
-                        .screen_width = FFMPEG_VIDEO_WIDTH,
-                        .screen_height = FFMPEG_VIDEO_HEIGHT,
-                        .delta_time = FFMPEG_VIDEO_DELTA_TIME,
-                        .rendering = true,
-                        .play_sound = dummy_play_sound,
-                    });
-                    EndTextureMode();
-
-                    Image image = LoadImageFromTexture(screen.texture);
-                    if (!ffmpeg_send_frame_flipped(ffmpeg_video, image.data, image.width, image.height)) {
-                        finish_ffmpeg_video_rendering(true);
-                    }
-                    UnloadImage(image);
+                } else if (!render_video_frame()) {
+                    finish_ffmpeg_video_rendering(true);
                 }
                 rendering_scene("Rendering Video");
             } else if (ffmpeg_audio) {
@@ -249,56 +1206,45 @@ int main(int argc, char **argv)
                     finish_ffmpeg_audio_rendering(false);
                 } else if (IsKeyPressed(KEY_ESCAPE)) {
                     finish_ffmpeg_audio_rendering(true);
-                } else {
-                    BeginTextureMode(screen);
-                    plug_update(CLITERAL(Env) {
-                        .screen_width = FFMPEG_VIDEO_WIDTH,
-                        .screen_height = FFMPEG_VIDEO_HEIGHT,
-                        .delta_time = FFMPEG_VIDEO_DELTA_TIME,
-                        .rendering = true,
-                        .play_sound = ffmpeg_play_sound,
-                    });
-                    EndTextureMode();
-
-                    size_t frame_count = ffmpeg_wave.frameCount;
-                    size_t frame_size = FFMPEG_SOUND_SAMPLE_SIZE_BYTES*FFMPEG_SOUND_CHANNELS;
-                    size_t frames_begin = ffmpeg_wave_cursor;
-                    size_t frames_end = ffmpeg_wave_cursor + FFMPEG_SOUND_SPF;
-                    if (frames_end > frame_count) {
-                        frames_end = frame_count;
-                    }
-                    void *sound_data = (uint8_t*)ffmpeg_wave.data + frames_begin*frame_size;
-                    size_t sound_size = (frames_end - frames_begin)*frame_size;
-                    if (!ffmpeg_send_sound_samples(ffmpeg_audio, sound_data, sound_size)) {
-                        finish_ffmpeg_audio_rendering(true);
-                    }
-                    ffmpeg_wave_cursor += frames_end - frames_begin;
-                    size_t silence_size = (FFMPEG_SOUND_SPF - (frames_end - frames_begin))*frame_size;
-                    if (!ffmpeg_send_sound_samples(ffmpeg_audio, silence, silence_size)) {
-                        finish_ffmpeg_audio_rendering(true);
-                    }
+                } else if (!render_audio_frame()) {
+                    finish_ffmpeg_audio_rendering(true);
                 }
                 rendering_scene("Rendering Audio");
             } else {
                 if (IsKeyPressed(KEY_R)) {
                     SetTraceLogLevel(LOG_WARNING);
-                    ffmpeg_video = ffmpeg_start_rendering_video("output.mp4", FFMPEG_VIDEO_WIDTH, FFMPEG_VIDEO_HEIGHT, FFMPEG_VIDEO_FPS);
+                    ffmpeg_video = ffmpeg_start_rendering_video_with_audio(PREVIEW_VIDEO_OUTPUT_PATH, &profile);
+                    if (ffmpeg_video) begin_video_frames();
+                    reset_ffmpeg_sound();
                     plug_reset();
                 } else if (IsKeyPressed(KEY_T)) {
                     SetTraceLogLevel(LOG_WARNING);
-                    ffmpeg_audio = ffmpeg_start_rendering_audio("output.wav");
+                    ffmpeg_audio = ffmpeg_start_rendering_audio("output.wav", &profile);
+                    reset_ffmpeg_sound();
                     plug_reset();
                 } else {
                     if (IsKeyPressed(KEY_H)) {
                         void *state = plug_pre_reload();
+                        // The sounds of the old code are unloaded by now
+                        soundconv_clear();
                         reload_libplug(libplug_path);
                         plug_post_reload(state);
+                        // The checkpoints are in the format of the old code
+                        checkpoints_clear();
+                        scrub_stale = true;
                     }
                     if (IsKeyPressed(KEY_SPACE)) {
                         paused = !paused;
                     }
                     if (IsKeyPressed(KEY_Q)) {
                         plug_reset();
+                        fixed_timestep_accumulator = 0.0;
+                        preview_time = 0.0;
+                    }
+                    if (IsKeyPressed(KEY_F)) {
+                        fixed_timestep = !fixed_timestep;
+                        fixed_timestep_accumulator = 0.0;
+                        TraceLog(LOG_INFO, "PANIM: fixed timestep %s", fixed_timestep ? "on" : "off");
                     }
                     if (IsKeyPressed(KEY_PERIOD)) {
                         delta_time_multiplier += 0.1;
@@ -313,13 +1259,9 @@ int main(int argc, char **argv)
                         delta_time_multiplier_popup = 1.0f;
                     }
 
-                    plug_update(CLITERAL(Env) {
-                        .screen_width = GetScreenWidth(),
-                        .screen_height = GetScreenHeight(),
-                        .delta_time = paused ? 0.0 : GetFrameTime()*delta_time_multiplier,
-                        .rendering = false,
-                        .play_sound = preview_play_sound,
-                    });
+                    scrubber_input();
+                    preview_update();
+                    scrubber_draw();
 
                     const char *text = TextFormat("Delta Time Multiplier: %.2fx", delta_time_multiplier);
                     Vector2 text_size = MeasureTextEx(rendering_font, text, RENDERING_FONT_SIZE, 0);
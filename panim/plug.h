@@ -18,4 +18,13 @@
     PLUG(plug_reset, void, void)        /* Reset the state of the animation */ \
     PLUG(plug_finished, bool, void)     /* Check if the animation is finished */ \
 
+// size_t plug_save(void *buffer, size_t size)
+// void plug_load(const void *buffer, size_t size)
+
+// The plugin may leave these out. Without them the preview has to simulate
+// the animation from the beginning every time it jumps to another frame.
+#define LIST_OF_OPTIONAL_PLUGS \
+    PLUG(plug_save, size_t, void*, size_t)      /* Save the state of the animation into the buffer if it fits and return its size, 0 if it can't be saved */ \
+    PLUG(plug_load, void, const void*, size_t)  /* Restore the state of the animation saved by plug_save() */ \
+
 #endif // PLUG_H_
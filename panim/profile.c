@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <raylib.h>
+
+#include "nob.h"
+#include "profile.h"
+
+static const Render_Profile builtin_profiles[] = {
+    // Cheap renders to check the timing of an animation
+    {
+        .name = "draft",
+        .width = 960,
+        .height = 540,
+        .fps = 30,
+        .video_codec = "libx264",
+        .preset = "ultrafast",
+        .video_bitrate = "1000k",
+        .audio_codec = "aac",
+        .audio_bitrate = "128k",
+        .sample_rate = 44100,
+        .channels = 2,
+    },
+    {
+        .name = "review",
+        .width = 1920,
+        .height = 1080,
+        .fps = 60,
+        .video_codec = "libx264",
+        .video_bitrate = "2500k",
+        .audio_codec = "aac",
+        .audio_bitrate = "200k",
+        .sample_rate = 44100,
+        .channels = 2,
+    },
+    // The final upload
+    {
+        .name = "master",
+        .width = 3840,
+        .height = 2160,
+        .fps = 60,
+        .video_codec = "libx264",
+        .preset = "slow",
+        .crf = 18,
+        .audio_codec = "aac",
+        .audio_bitrate = "320k",
+        .sample_rate = 44100,
+        .channels = 2,
+    },
+};
+#define BUILTIN_PROFILES_COUNT (sizeof(builtin_profiles)/sizeof(builtin_profiles[0]))
+
+Render_Profile profile_default(void)
+{
+    return builtin_profiles[1];
+}
+
+static const Render_Profile *find_builtin(Nob_String_View name)
+{
+    for (size_t i = 0; i < BUILTIN_PROFILES_COUNT; ++i) {
+        if (nob_sv_eq(name, nob_sv_from_cstr(builtin_profiles[i].name))) return &builtin_profiles[i];
+    }
+    return NULL;
+}
+
+static bool parse_size(Nob_String_View value, size_t *result)
+{
+    char buffer[32];
+    if (value.count == 0 || value.count >= sizeof(buffer)) return false;
+    memcpy(buffer, value.data, value.count);
+    buffer[value.count] = '\0';
+
+    char *endptr = NULL;
+    long long x = strtoll(buffer, &endptr, 10);
+    if (*endptr != '\0' || x <= 0) return false;
+    *result = x;
+    return true;
+}
+
+static bool copy_string(Nob_String_View value, char *dst, size_t dst_size)
+{
+    if (value.count >= dst_size) return false;
+    memcpy(dst, value.data, value.count);
+    dst[value.count] = '\0';
+    return true;
+}
+
+static bool set_field(Render_Profile *profile, Nob_String_View key, Nob_String_View value)
+{
+    #define STRING_FIELD(field) \
+        if (nob_sv_eq(key, nob_sv_from_cstr(#field))) return copy_string(value, profile->field, sizeof(profile->field));
+    #define SIZE_FIELD(field) \
+        if (nob_sv_eq(key, nob_sv_from_cstr(#field))) return parse_size(value, &profile->field);
+    STRING_FIELD(name);
+    SIZE_FIELD(width);
+    SIZE_FIELD(height);
+    SIZE_FIELD(fps);
+    STRING_FIELD(video_codec);
+    STRING_FIELD(preset);
+    STRING_FIELD(video_bitrate);
+    STRING_FIELD(audio_codec);
+    STRING_FIELD(audio_bitrate);
+    SIZE_FIELD(sample_rate);
+    SIZE_FIELD(channels);
+    #undef STRING_FIELD
+    #undef SIZE_FIELD
+
+    if (nob_sv_eq(key, nob_sv_from_cstr("crf"))) {
+        size_t crf = 0;
+        // 0 is a valid crf (lossless)
+        if (nob_sv_eq(value, nob_sv_from_cstr("0"))) crf = 0;
+        else if (!parse_size(value, &crf)) return false;
+        profile->crf = crf;
+        // Picking a crf switches from constant bitrate to constant quality
+        profile->video_bitrate[0] = '\0';
+        return true;
+    }
+    if (nob_sv_eq(key, nob_sv_from_cstr("yuv420p"))) {
+        if (nob_sv_eq(value, nob_sv_from_cstr("true"))) profile->yuv420p = true;
+        else if (nob_sv_eq(value, nob_sv_from_cstr("false"))) profile->yuv420p = false;
+        else return false;
+        return true;
+    }
+
+    TraceLog(LOG_ERROR, "PROFILE: unknown key "SV_Fmt, SV_Arg(key));
+    return false;
+}
+
+static bool load_profile_file(const char *path, Render_Profile *profile)
+{
+    Nob_String_Builder sb = {0};
+    if (!nob_read_entire_file(path, &sb)) return false;
+
+    bool result = true;
+    *profile = profile_default();
+    // The name of the file is a better default than the name of the base
+    copy_string(nob_sv_from_cstr(path), profile->name, sizeof(profile->name));
+
+    Nob_String_View content = nob_sb_to_sv(sb);
+    for (size_t row = 1; content.count > 0; ++row) {
+        Nob_String_View line = nob_sv_trim(nob_sv_chop_by_delim(&content, '\n'));
+        if (line.count == 0 || line.data[0] == '#') continue;
+
+        Nob_String_View key = nob_sv_trim(nob_sv_chop_by_delim(&line, '='));
+        Nob_String_View value = nob_sv_trim(line);
+
+        if (nob_sv_eq(key, nob_sv_from_cstr("base"))) {
+            const Render_Profile *base = find_builtin(value);
+            if (base == NULL) {
+                TraceLog(LOG_ERROR, "PROFILE: %s:%zu: unknown base profile "SV_Fmt, path, row, SV_Arg(value));
+                nob_return_defer(false);
+            }
+            Render_Profile named = *profile;
+            *profile = *base;
+            memcpy(profile->name, named.name, sizeof(profile->name));
+            continue;
+        }
+
+        if (!set_field(profile, key, value)) {
+            TraceLog(LOG_ERROR, "PROFILE: %s:%zu: invalid value "SV_Fmt" for "SV_Fmt, path, row, SV_Arg(value), SV_Arg(key));
+            nob_return_defer(false);
+        }
+    }
+
+defer:
+    nob_sb_free(sb);
+    return result;
+}
+
+bool profile_load(const char *name, Render_Profile *profile)
+{
+    const Render_Profile *builtin = find_builtin(nob_sv_from_cstr(name));
+    if (builtin != NULL) {
+        *profile = *builtin;
+        return true;
+    }
+    return load_profile_file(name, profile);
+}
+
+void profile_print_builtins(void)
+{
+    for (size_t i = 0; i < BUILTIN_PROFILES_COUNT; ++i) {
+        const Render_Profile *p = &builtin_profiles[i];
+        fprintf(stderr, "        %-8s %zux%zu@%zu %s", p->name, p->width, p->height, p->fps, p->video_codec);
+        if (p->preset[0] != '\0') fprintf(stderr, " %s", p->preset);
+        if (p->video_bitrate[0] != '\0') fprintf(stderr, " %s", p->video_bitrate);
+        else fprintf(stderr, " crf %d", p->crf);
+        fprintf(stderr, "%s\n", p == &builtin_profiles[1] ? " (default)" : "");
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Everything about the rendered video that can change between renders
+// without recompiling the engine.
+typedef struct {
+    char name[64];
+    size_t width;
+    size_t height;
+    size_t fps;
+    char video_codec[32];
+    // Empty means the default preset of the codec
+    char preset[32];
+    // Constant bitrate when set, constant quality with crf otherwise
+    char video_bitrate[32];
+    int crf;
+    char audio_codec[32];
+    char audio_bitrate[32];
+    size_t sample_rate;
+    size_t channels;
+    // Convert the frames to yuv420p on our side instead of in ffmpeg
+    bool yuv420p;
+} Render_Profile;
+
+// The profile used when none is picked
+Render_Profile profile_default(void);
+// Picks one of the built-in profiles (draft, review, master) by name,
+// otherwise loads name as a profile file. A profile file is made of
+// `key = value` lines, with the keys named after the fields of
+// Render_Profile, and starts off from the `base` profile (review by default).
+bool profile_load(const char *name, Render_Profile *profile);
+// Lists the built-in profiles for the usage message
+void profile_print_builtins(void);
+
+#endif // PROFILE_H_
@@ -0,0 +1,254 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <raylib.h>
+#include <rlgl.h>
+
+#include "readback.h"
+
+#define GL_UNSIGNED_BYTE 0x1401
+#define GL_RGBA 0x1908
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#define GL_STREAM_READ 0x88E1
+#define GL_MAP_READ_BIT 0x0001
+
+struct Readback {
+    size_t width;
+    size_t height;
+    size_t depth;
+
+    // Pixel-pack buffer ring. It has one buffer more than depth, so the frame
+    // handed out before the current one stays mapped as well. When pixel-pack
+    // buffers are not available buffers is NULL and the frames are read
+    // synchronously into pixels.
+    unsigned int *buffers;
+    size_t count;
+    size_t head;
+    size_t pending;
+    void *current;
+    size_t current_index;
+    void *previous;
+    size_t previous_index;
+
+    void *pixels;
+    void *previous_pixels;
+};
+
+// OpenGL functions use the stdcall convention on Windows
+#ifdef _WIN32
+#define GLAPIENTRY __stdcall
+#else
+#define GLAPIENTRY
+#endif // _WIN32
+
+typedef void (*gl_proc_t)(void);
+
+static void (GLAPIENTRY *glGenBuffers)(int n, unsigned int *buffers);
+static void (GLAPIENTRY *glDeleteBuffers)(int n, const unsigned int *buffers);
+static void (GLAPIENTRY *glBindBuffer)(unsigned int target, unsigned int buffer);
+static void (GLAPIENTRY *glBufferData)(unsigned int target, intptr_t size, const void *data, unsigned int usage);
+static void *(GLAPIENTRY *glMapBufferRange)(unsigned int target, intptr_t offset, intptr_t length, unsigned int access);
+static unsigned char (GLAPIENTRY *glUnmapBuffer)(unsigned int target);
+static void (GLAPIENTRY *glReadPixels)(int x, int y, int width, int height, unsigned int format, unsigned int type, void *pixels);
+
+#ifndef _WIN32
+// raylib does not expose the pixel-pack buffer API, but it does export the
+// GLFW it is built with, so we can look the functions up in its context.
+gl_proc_t glfwGetProcAddress(const char *procname);
+
+static gl_proc_t get_gl_proc(const char *name)
+{
+    return glfwGetProcAddress(name);
+}
+#else
+// raylib.dll does not export its GLFW, so the functions come from the
+// opengl32.dll it has loaded. That one exports the OpenGL 1.1 functions itself
+// and hands out the newer ones of the current context via wglGetProcAddress().
+__declspec(dllimport) void *__stdcall GetModuleHandleA(const char *module_name);
+__declspec(dllimport) gl_proc_t __stdcall GetProcAddress(void *module, const char *proc_name);
+
+static gl_proc_t get_gl_proc(const char *name)
+{
+    void *opengl32 = GetModuleHandleA("opengl32.dll");
+    if (opengl32 == NULL) return NULL;
+    gl_proc_t proc = GetProcAddress(opengl32, name);
+    if (proc != NULL) return proc;
+
+    gl_proc_t (__stdcall *wglGetProcAddress)(const char *procname);
+    proc = GetProcAddress(opengl32, "wglGetProcAddress");
+    if (proc == NULL) return NULL;
+    memcpy(&wglGetProcAddress, &proc, sizeof(wglGetProcAddress));
+    proc = wglGetProcAddress(name);
+    // Some drivers return small numbers instead of NULL when they fail
+    intptr_t address;
+    memcpy(&address, &proc, sizeof(address));
+    if (address >= -1 && address <= 3) return NULL;
+    return proc;
+}
+#endif // _WIN32
+
+static bool load_gl_procs(void)
+{
+    // The object pointer gets the address through memcpy() rather than a cast
+    // of its address, which would break strict aliasing
+    #define LOAD_GL_PROC(name) \
+        do { \
+            gl_proc_t proc = get_gl_proc(#name); \
+            if (proc == NULL) return false; \
+            memcpy(&name, &proc, sizeof(name)); \
+        } while (0)
+    LOAD_GL_PROC(glGenBuffers);
+    LOAD_GL_PROC(glDeleteBuffers);
+    LOAD_GL_PROC(glBindBuffer);
+    LOAD_GL_PROC(glBufferData);
+    LOAD_GL_PROC(glMapBufferRange);
+    LOAD_GL_PROC(glUnmapBuffer);
+    LOAD_GL_PROC(glReadPixels);
+    #undef LOAD_GL_PROC
+    return true;
+}
+
+static size_t frame_size(Readback *rb)
+{
+    return rb->width*rb->height*sizeof(uint32_t);
+}
+
+Readback *readback_create(size_t width, size_t height, size_t depth)
+{
+    assert(depth > 0);
+
+    Readback *rb = malloc(sizeof(Readback));
+    assert(rb != NULL && "Buy MORE RAM lol!!");
+    *rb = (Readback) {
+        .width = width,
+        .height = height,
+        .depth = depth,
+    };
+
+    if (!load_gl_procs()) {
+        TraceLog(LOG_WARNING, "READBACK: pixel-pack buffers are not available, reading frames synchronously");
+        return rb;
+    }
+
+    rb->count = depth + 1;
+    rb->buffers = malloc(sizeof(*rb->buffers)*rb->count);
+    assert(rb->buffers != NULL && "Buy MORE RAM lol!!");
+    glGenBuffers(rb->count, rb->buffers);
+    for (size_t i = 0; i < rb->count; ++i) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->buffers[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, frame_size(rb), NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    return rb;
+}
+
+static void unmap(Readback *rb, size_t index)
+{
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->buffers[index]);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+static void unmap_all(Readback *rb)
+{
+    if (rb->current != NULL) unmap(rb, rb->current_index);
+    if (rb->previous != NULL) unmap(rb, rb->previous_index);
+    rb->current = NULL;
+    rb->previous = NULL;
+}
+
+// The frame handed out last becomes the previous one. The buffer of the one
+// before it gets unmapped, which is the buffer the next frame is read into.
+static void retire_current(Readback *rb)
+{
+    if (rb->previous != NULL) unmap(rb, rb->previous_index);
+    rb->previous = rb->current;
+    rb->previous_index = rb->current_index;
+    rb->current = NULL;
+}
+
+static bool map_oldest(Readback *rb, void **pixels)
+{
+    assert(rb->pending > 0);
+    size_t index = (rb->head + rb->count - rb->pending)%rb->count;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->buffers[index]);
+    *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frame_size(rb), GL_MAP_READ_BIT);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    rb->pending -= 1;
+    if (*pixels == NULL) {
+        TraceLog(LOG_ERROR, "READBACK: could not map pixel-pack buffer %zu", index);
+        return false;
+    }
+    rb->current = *pixels;
+    rb->current_index = index;
+    return true;
+}
+
+bool readback_push(Readback *rb, RenderTexture2D target, void **pixels)
+{
+    *pixels = NULL;
+    if (rb->buffers == NULL) {
+        RL_FREE(rb->previous_pixels);
+        rb->previous_pixels = rb->pixels;
+        rb->pixels = rlReadTexturePixels(target.texture.id, target.texture.width, target.texture.height, target.texture.format);
+        if (rb->pixels == NULL) {
+            TraceLog(LOG_ERROR, "READBACK: could not read the pixels of the frame");
+            return false;
+        }
+        *pixels = rb->pixels;
+        return true;
+    }
+
+    retire_current(rb);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->buffers[rb->head]);
+    rlEnableFramebuffer(target.id);
+    glReadPixels(0, 0, rb->width, rb->height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    rlDisableFramebuffer();
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    rb->head = (rb->head + 1)%rb->count;
+    rb->pending += 1;
+
+    if (rb->pending < rb->depth) return true;
+    return map_oldest(rb, pixels);
+}
+
+bool readback_pop(Readback *rb, void **pixels)
+{
+    *pixels = NULL;
+    if (rb->buffers == NULL) return true;
+
+    retire_current(rb);
+    if (rb->pending == 0) return true;
+    return map_oldest(rb, pixels);
+}
+
+void readback_discard(Readback *rb)
+{
+    if (rb->buffers == NULL) return;
+
+    unmap_all(rb);
+    rb->pending = 0;
+}
+
+const void *readback_previous(Readback *rb)
+{
+    if (rb->buffers == NULL) return rb->previous_pixels;
+    return rb->previous;
+}
+
+void readback_destroy(Readback *rb)
+{
+    if (rb->buffers != NULL) {
+        unmap_all(rb);
+        glDeleteBuffers(rb->count, rb->buffers);
+        free(rb->buffers);
+    }
+    RL_FREE(rb->pixels);
+    RL_FREE(rb->previous_pixels);
+    free(rb);
+}
@@ -0,0 +1,32 @@
+#ifndef READBACK_H_
+#define READBACK_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <raylib.h>
+
+// Asynchronous readback of rendered frames through a ring of pixel-pack
+// buffers. readback_push() only schedules the transfer of the frame that was
+// just drawn and hands back the pixels of the frame scheduled depth-1 pushes
+// ago, so the GPU copies one frame while the next ones are being drawn.
+//
+// The returned pixels are RGBA8, bottom-up (the way OpenGL stores them) and
+// stay valid until the next readback_push()/readback_pop()/readback_destroy().
+
+typedef struct Readback Readback;
+
+Readback *readback_create(size_t width, size_t height, size_t depth);
+// Sets *pixels to NULL while the ring is still filling up. Returns false if
+// the frame could not be read back, the frame is lost then.
+bool readback_push(Readback *rb, RenderTexture2D target, void **pixels);
+// Sets *pixels to the oldest frame that is still in flight or to NULL if
+// there are none. Returns false if that frame could not be read back.
+bool readback_pop(Readback *rb, void **pixels);
+// The pixels of the frame handed out before the last one or NULL if there is
+// none, valid for as long as the last one
+const void *readback_previous(Readback *rb);
+// Forgets all the frames that are still in flight
+void readback_discard(Readback *rb);
+void readback_destroy(Readback *rb);
+
+#endif // READBACK_H_
@@ -0,0 +1,299 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "nob.h"
+#include "soundconv.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SOUNDCONV_AVX2
+#include <immintrin.h>
+#endif
+
+// How many zero crossings of the sinc the filter keeps on each side. More is
+// a sharper cutoff for a longer filter.
+#define SOUNDCONV_ZERO_CROSSINGS 16
+// Ratios that need more phases than that get the position rounded to the nearest one
+#define SOUNDCONV_MAX_PHASES 512
+
+typedef struct {
+    // The Sound and Wave and the format it was converted to. The buffer of the
+    // Sound tells apart sounds whose samples ended up at the same address.
+    const void *buffer;
+    const void *data;
+    unsigned int frame_count;
+    unsigned int sample_rate;
+    unsigned int sample_size;
+    unsigned int channels;
+    size_t target_rate;
+    size_t target_channels;
+
+    // NULL if the conversion failed, so it's not attempted on every play
+    int16_t *samples;
+    size_t samples_frame_count;
+} Converted;
+
+typedef struct {
+    Converted *items;
+    size_t count;
+    size_t capacity;
+} Converted_Cache;
+
+static Converted_Cache cache = {0};
+
+static float read_sample(const uint8_t *data, unsigned int sample_size, size_t index)
+{
+    switch (sample_size) {
+    case 8:  return (data[index] - 128)/128.0f;
+    case 16: {
+        int16_t x;
+        memcpy(&x, data + index*2, sizeof(x));
+        return x/32768.0f;
+    }
+    case 24: {
+        const uint8_t *p = data + index*3;
+        int32_t x = (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24) >> 8;
+        return x/8388608.0f;
+    }
+    case 32: {
+        float x;
+        memcpy(&x, data + index*4, sizeof(x));
+        return x;
+    }
+    }
+    assert(0 && "unreachable");
+    return 0.0f;
+}
+
+// Decodes the wave into one plane of floats per output channel. Mono is
+// copied to every channel, and extra channels are averaged into the ones we
+// have. Each plane has pad frames of silence on both sides for the filter.
+static float *decode_planes(Wave wave, size_t channels, size_t pad)
+{
+    size_t stride = wave.frameCount + 2*pad;
+    float *planes = calloc(channels*stride, sizeof(float));
+    assert(planes != NULL && "Buy MORE RAM lol!!");
+
+    for (size_t c = 0; c < channels; ++c) {
+        float *plane = planes + c*stride + pad;
+        if (wave.channels <= channels) {
+            size_t source = c%wave.channels;
+            for (size_t i = 0; i < wave.frameCount; ++i) {
+                plane[i] = read_sample(wave.data, wave.sampleSize, i*wave.channels + source);
+            }
+        } else {
+            size_t sources = 0;
+            for (size_t source = c; source < wave.channels; source += channels) {
+                for (size_t i = 0; i < wave.frameCount; ++i) {
+                    plane[i] += read_sample(wave.data, wave.sampleSize, i*wave.channels + source);
+                }
+                sources += 1;
+            }
+            for (size_t i = 0; i < wave.frameCount; ++i) plane[i] /= sources;
+        }
+    }
+    return planes;
+}
+
+static size_t gcd(size_t a, size_t b)
+{
+    while (b != 0) {
+        size_t t = a%b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Output frame i sits at input position i*down/up. The fractional part of
+// that position picks one of the phases, a row of taps coefficients for the
+// input frames around it.
+typedef struct {
+    size_t up;
+    size_t down;
+    size_t phases;
+    size_t half;
+    size_t taps;
+    float *coeffs;
+} Polyphase;
+
+static double sinc(double x)
+{
+    if (x == 0.0) return 1.0;
+    return sin(PI*x)/(PI*x);
+}
+
+static void polyphase_init(Polyphase *pf, size_t in_rate, size_t out_rate)
+{
+    size_t g = gcd(in_rate, out_rate);
+    pf->up = out_rate/g;
+    pf->down = in_rate/g;
+    pf->phases = pf->up <= SOUNDCONV_MAX_PHASES ? pf->up : SOUNDCONV_MAX_PHASES;
+
+    // When downsampling the cutoff goes down to the new Nyquist frequency,
+    // which stretches the sinc and needs proportionally more taps
+    double cutoff = pf->up < pf->down ? (double)pf->up/pf->down : 1.0;
+    pf->half = (size_t)ceil(SOUNDCONV_ZERO_CROSSINGS/cutoff);
+    pf->half = (pf->half + 3)&~(size_t)3;
+    pf->taps = 2*pf->half;
+
+    pf->coeffs = malloc(sizeof(float)*pf->phases*pf->taps);
+    assert(pf->coeffs != NULL && "Buy MORE RAM lol!!");
+    for (size_t p = 0; p < pf->phases; ++p) {
+        double frac = (double)p/pf->phases;
+        float *row = pf->coeffs + p*pf->taps;
+        double sum = 0.0;
+        for (size_t k = 0; k < pf->taps; ++k) {
+            // Distance of the input frame from the position of the output frame
+            double x = (double)k - (double)pf->half + 1.0 - frac;
+            double t = x/pf->half;
+            double window = fabs(t) < 1.0 ? 0.42 + 0.5*cos(PI*t) + 0.08*cos(2.0*PI*t) : 0.0;
+            double h = cutoff*sinc(cutoff*x)*window;
+            row[k] = h;
+            sum += h;
+        }
+        // Unity gain for DC in every phase
+        for (size_t k = 0; k < pf->taps; ++k) row[k] /= sum;
+    }
+}
+
+static float dot_scalar(const float *a, const float *b, size_t count)
+{
+    float result = 0.0f;
+    for (size_t i = 0; i < count; ++i) result += a[i]*b[i];
+    return result;
+}
+
+#ifdef SOUNDCONV_AVX2
+// count is always a multiple of 8, see polyphase_init()
+__attribute__((target("avx2")))
+static float dot_avx2(const float *a, const float *b, size_t count)
+{
+    __m256 acc = _mm256_setzero_ps();
+    for (size_t i = 0; i < count; i += 8) {
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    }
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+static bool has_avx2(void)
+{
+    static int cached = -1;
+    if (cached < 0) cached = __builtin_cpu_supports("avx2") ? 1 : 0;
+    return cached;
+}
+#endif // SOUNDCONV_AVX2
+
+// in has pf->half + 1 frames of padding before in[0] and after in[in_count - 1],
+// the one frame more is for the positions that get rounded up to the next frame
+static void resample_plane(const Polyphase *pf, const float *in, float *out, size_t out_count)
+{
+    float (*dot)(const float*, const float*, size_t) = dot_scalar;
+#ifdef SOUNDCONV_AVX2
+    if (has_avx2()) dot = dot_avx2;
+#endif // SOUNDCONV_AVX2
+
+    for (size_t i = 0; i < out_count; ++i) {
+        uint64_t position = (uint64_t)i*pf->down;
+        size_t index = position/pf->up;
+        size_t phase = ((position%pf->up)*pf->phases + pf->up/2)/pf->up;
+        if (phase == pf->phases) {
+            phase = 0;
+            index += 1;
+        }
+        out[i] = dot(pf->coeffs + phase*pf->taps, in + index - pf->half + 1, pf->taps);
+    }
+}
+
+static int16_t to_s16(float x)
+{
+    x *= 32768.0f;
+    if (x > INT16_MAX) x = INT16_MAX;
+    if (x < INT16_MIN) x = INT16_MIN;
+    return (int16_t)lrintf(x);
+}
+
+static int16_t *convert(Wave wave, size_t sample_rate, size_t channels, size_t *frame_count)
+{
+    bool resample = wave.sampleRate != sample_rate;
+    Polyphase pf = {0};
+    if (resample) polyphase_init(&pf, wave.sampleRate, sample_rate);
+
+    float *planes = decode_planes(wave, channels, pf.half + 1);
+    size_t in_stride = wave.frameCount + 2*(pf.half + 1);
+    size_t out_count = resample ? ((uint64_t)wave.frameCount*pf.up + pf.down - 1)/pf.down : wave.frameCount;
+
+    int16_t *samples = malloc(sizeof(int16_t)*out_count*channels);
+    float *plane = malloc(sizeof(float)*out_count);
+    assert(samples != NULL && plane != NULL && "Buy MORE RAM lol!!");
+    for (size_t c = 0; c < channels; ++c) {
+        const float *in = planes + c*in_stride + pf.half + 1;
+        if (resample) resample_plane(&pf, in, plane, out_count);
+        else memcpy(plane, in, sizeof(float)*out_count);
+        for (size_t i = 0; i < out_count; ++i) samples[i*channels + c] = to_s16(plane[i]);
+    }
+
+    free(plane);
+    free(planes);
+    free(pf.coeffs);
+    *frame_count = out_count;
+    return samples;
+}
+
+const int16_t *soundconv_get(Sound sound, Wave wave, size_t sample_rate, size_t channels, size_t *frame_count)
+{
+    if (wave.sampleRate == sample_rate && wave.sampleSize == 16 && wave.channels == channels) {
+        *frame_count = wave.frameCount;
+        return wave.data;
+    }
+
+    for (size_t i = 0; i < cache.count; ++i) {
+        Converted *it = &cache.items[i];
+        if (it->buffer == sound.stream.buffer && it->data == wave.data && it->frame_count == wave.frameCount &&
+            it->sample_rate == wave.sampleRate && it->sample_size == wave.sampleSize &&
+            it->channels == wave.channels &&
+            it->target_rate == sample_rate && it->target_channels == channels) {
+            *frame_count = it->samples_frame_count;
+            return it->samples;
+        }
+    }
+
+    Converted converted = {
+        .buffer = sound.stream.buffer,
+        .data = wave.data,
+        .frame_count = wave.frameCount,
+        .sample_rate = wave.sampleRate,
+        .sample_size = wave.sampleSize,
+        .channels = wave.channels,
+        .target_rate = sample_rate,
+        .target_channels = channels,
+    };
+    bool supported = wave.data != NULL && wave.sampleRate > 0 && wave.channels > 0 &&
+        (wave.sampleSize == 8 || wave.sampleSize == 16 || wave.sampleSize == 24 || wave.sampleSize == 32);
+    if (supported) {
+        converted.samples = convert(wave, sample_rate, channels, &converted.samples_frame_count);
+        TraceLog(LOG_INFO, "SOUNDCONV: converted %u frames of %uhz %u bit %u channels into %zu frames of %zuhz 16 bit %zu channels",
+                 wave.frameCount, wave.sampleRate, wave.sampleSize, wave.channels,
+                 converted.samples_frame_count, sample_rate, channels);
+    } else {
+        TraceLog(LOG_ERROR, "SOUNDCONV: can't convert sound with rate: %uhz, sample size: %u bits, channels: %u",
+                 wave.sampleRate, wave.sampleSize, wave.channels);
+    }
+    nob_da_append(&cache, converted);
+
+    *frame_count = converted.samples_frame_count;
+    return converted.samples;
+}
+
+void soundconv_clear(void)
+{
+    for (size_t i = 0; i < cache.count; ++i) {
+        free(cache.items[i].samples);
+    }
+    cache.count = 0;
+}
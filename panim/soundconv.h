@@ -0,0 +1,23 @@
+#ifndef SOUNDCONV_H_
+#define SOUNDCONV_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <raylib.h>
+
+// Brings the Waves of the animation to the format of the render: interleaved
+// s16 at sample_rate with channels. Any rate is resampled with a windowed
+// sinc polyphase filter, the channels are up- or downmixed, and 8, 16, 24 bit
+// and float samples are accepted. The result is cached per sound, so only the
+// first play of a sound pays for the conversion.
+
+// Returns NULL if the wave can't be converted. Waves that already are in the
+// right format are handed out as they are. The result is cached for the pair
+// of sound and wave.
+const int16_t *soundconv_get(Sound sound, Wave wave, size_t sample_rate, size_t channels, size_t *frame_count);
+// Frees all the cached conversions. Has to be called whenever the sounds they
+// came from may be gone, like when the plugin gets reloaded.
+void soundconv_clear(void);
+
+#endif // SOUNDCONV_H_
@@ -0,0 +1,193 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <raylib.h>
+
+#include "nob.h"
+#include "trace.h"
+
+typedef struct {
+    double begin;
+    double end;
+    double stage_begin[COUNT_TRACE_STAGES];
+    double stage_secs[COUNT_TRACE_STAGES];
+} Trace_Frame;
+
+typedef struct {
+    Trace_Frame *items;
+    size_t count;
+    size_t capacity;
+} Trace_Frames;
+
+static const char *stage_names[COUNT_TRACE_STAGES] = {
+    [TRACE_UPDATE]      = "update",
+    [TRACE_END_TEXTURE] = "end_texture",
+    [TRACE_SOUND]       = "sound",
+    [TRACE_READBACK]    = "readback",
+    [TRACE_HASH]        = "hash",
+    [TRACE_SEND]        = "send",
+};
+
+static Trace_Frames frames = {0};
+static Trace_Frame current = {0};
+static bool in_frame = false;
+
+void trace_reset(void)
+{
+    frames.count = 0;
+    in_frame = false;
+}
+
+double trace_now(void)
+{
+    return GetTime();
+}
+
+void trace_frame_begin(void)
+{
+    memset(&current, 0, sizeof(current));
+    current.begin = trace_now();
+    in_frame = true;
+}
+
+void trace_span(Trace_Stage stage, double begin)
+{
+    assert(stage < COUNT_TRACE_STAGES);
+    if (!in_frame) return;
+    if (current.stage_secs[stage] == 0.0) current.stage_begin[stage] = begin;
+    current.stage_secs[stage] += trace_now() - begin;
+}
+
+void trace_frame_end(void)
+{
+    if (!in_frame) return;
+    current.end = trace_now();
+    nob_da_append(&frames, current);
+    in_frame = false;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted xs
+static double percentile(const double *xs, size_t count, double p)
+{
+    size_t rank = (size_t)(p/100.0*count + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return xs[rank - 1];
+}
+
+size_t trace_frame_count(void)
+{
+    return frames.count;
+}
+
+double trace_frame_percentile(double p)
+{
+    if (frames.count == 0) return 0.0;
+
+    double *xs = malloc(sizeof(*xs)*frames.count);
+    assert(xs != NULL && "Buy MORE RAM lol!!");
+    for (size_t i = 0; i < frames.count; ++i) xs[i] = frames.items[i].end - frames.items[i].begin;
+    qsort(xs, frames.count, sizeof(*xs), compare_doubles);
+    double result = percentile(xs, frames.count, p);
+    free(xs);
+    return result;
+}
+
+static void log_percentiles(const char *name, double *xs, size_t count)
+{
+    qsort(xs, count, sizeof(*xs), compare_doubles);
+    TraceLog(LOG_INFO, "TRACE: %-12s p50 %8.3fms  p95 %8.3fms  p99 %8.3fms  max %8.3fms",
+             name,
+             percentile(xs, count, 50)*1000.0,
+             percentile(xs, count, 95)*1000.0,
+             percentile(xs, count, 99)*1000.0,
+             xs[count - 1]*1000.0);
+}
+
+static bool write_chrome_trace(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        TraceLog(LOG_ERROR, "TRACE: could not open %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    // Timestamps and durations are in microseconds
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (size_t i = 0; i < frames.count; ++i) {
+        const Trace_Frame *frame = &frames.items[i];
+        fprintf(f, "%s{\"name\":\"frame\",\"cat\":\"panim\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%zu}}",
+                i == 0 ? "" : ",\n", frame->begin*1e6, (frame->end - frame->begin)*1e6, i);
+        for (size_t stage = 0; stage < COUNT_TRACE_STAGES; ++stage) {
+            if (frame->stage_secs[stage] == 0.0) continue;
+            fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"panim\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                    stage_names[stage], frame->stage_begin[stage]*1e6, frame->stage_secs[stage]*1e6);
+        }
+    }
+    fprintf(f, "\n]}\n");
+
+    bool ok = !ferror(f);
+    if (fclose(f) != 0) ok = false;
+    if (!ok) TraceLog(LOG_ERROR, "TRACE: could not write %s: %s", path, strerror(errno));
+    return ok;
+}
+
+static bool write_csv(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        TraceLog(LOG_ERROR, "TRACE: could not open %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    fprintf(f, "frame,begin_ms");
+    for (size_t stage = 0; stage < COUNT_TRACE_STAGES; ++stage) fprintf(f, ",%s_ms", stage_names[stage]);
+    fprintf(f, ",total_ms\n");
+    for (size_t i = 0; i < frames.count; ++i) {
+        const Trace_Frame *frame = &frames.items[i];
+        fprintf(f, "%zu,%.3f", i, frame->begin*1000.0);
+        for (size_t stage = 0; stage < COUNT_TRACE_STAGES; ++stage) fprintf(f, ",%.3f", frame->stage_secs[stage]*1000.0);
+        fprintf(f, ",%.3f\n", (frame->end - frame->begin)*1000.0);
+    }
+
+    bool ok = !ferror(f);
+    if (fclose(f) != 0) ok = false;
+    if (!ok) TraceLog(LOG_ERROR, "TRACE: could not write %s: %s", path, strerror(errno));
+    return ok;
+}
+
+bool trace_report(const char *output_path)
+{
+    if (frames.count == 0) return true;
+
+    double *xs = malloc(sizeof(*xs)*frames.count);
+    assert(xs != NULL && "Buy MORE RAM lol!!");
+    TraceLog(LOG_INFO, "TRACE: %zu frames", frames.count);
+    for (size_t stage = 0; stage < COUNT_TRACE_STAGES; ++stage) {
+        for (size_t i = 0; i < frames.count; ++i) xs[i] = frames.items[i].stage_secs[stage];
+        log_percentiles(stage_names[stage], xs, frames.count);
+    }
+    for (size_t i = 0; i < frames.count; ++i) xs[i] = frames.items[i].end - frames.items[i].begin;
+    log_percentiles("total", xs, frames.count);
+    free(xs);
+
+    if (output_path == NULL) return true;
+
+    bool ok = true;
+    const char *trace_path = nob_temp_sprintf("%s.trace.json", output_path);
+    if (!write_chrome_trace(trace_path)) ok = false;
+    const char *csv_path = nob_temp_sprintf("%s.frames.csv", output_path);
+    if (!write_csv(csv_path)) ok = false;
+    if (ok) TraceLog(LOG_INFO, "TRACE: wrote %s and %s", trace_path, csv_path);
+    return ok;
+}
@@ -0,0 +1,38 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Timing of the stages of the render loop. Every frame is a row of stage
+// durations. At the end of a render the percentiles of each stage are logged,
+// and the rows can be dumped as a Chrome trace (chrome://tracing, Perfetto)
+// and as a CSV.
+//
+//     double begin = trace_now();
+//     plug_update(...);
+//     trace_span(TRACE_UPDATE, begin);
+
+typedef enum {
+    TRACE_UPDATE,       // BeginTextureMode() and plug_update()
+    TRACE_END_TEXTURE,  // EndTextureMode(), flushes raylib's batch to the GPU
+    TRACE_SOUND,        // Sound samples into the audio pipe
+    TRACE_READBACK,     // Getting the pixels back from the GPU
+    TRACE_HASH,         // Looking for a repeated frame
+    TRACE_SEND,         // Handing the frame over to ffmpeg, including the backpressure
+    COUNT_TRACE_STAGES,
+} Trace_Stage;
+
+void trace_reset(void);
+double trace_now(void);
+void trace_frame_begin(void);
+void trace_span(Trace_Stage stage, double begin);
+void trace_frame_end(void);
+size_t trace_frame_count(void);
+// Percentile p (0-100) of the duration of the whole frame in seconds
+double trace_frame_percentile(double p);
+// Logs the p50/p95/p99 of every stage. If output_path is not NULL also writes
+// <output_path>.trace.json and <output_path>.frames.csv
+bool trace_report(const char *output_path);
+
+#endif // TRACE_H_
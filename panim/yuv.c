@@ -0,0 +1,173 @@
+#include <stdbool.h>
+
+#include "yuv.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define YUV_AVX2
+#include <immintrin.h>
+#endif
+
+size_t yuv420p_size(size_t width, size_t height)
+{
+    size_t chroma_width = (width + 1)/2;
+    size_t chroma_height = (height + 1)/2;
+    return width*height + 2*chroma_width*chroma_height;
+}
+
+// Integer BT.601 limited range coefficients. For chroma r, g, b are the sums
+// of the 2x2 block of pixels, hence the extra 2 bits of shift.
+static inline uint8_t luma(int r, int g, int b)
+{
+    return ((66*r + 129*g + 25*b + 128) >> 8) + 16;
+}
+
+static inline uint8_t chroma_u(int r, int g, int b)
+{
+    return ((-38*r - 74*g + 112*b + 512) >> 10) + 128;
+}
+
+static inline uint8_t chroma_v(int r, int g, int b)
+{
+    return ((112*r - 94*g - 18*b + 512) >> 10) + 128;
+}
+
+// Converts the pixels [x, width) of a pair of rows. src1 == src0 and
+// y1 == NULL when the frame has an odd height and this is its last row.
+static void convert_row_pair_scalar(const uint8_t *src0, const uint8_t *src1, size_t width, size_t x,
+                                    uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v)
+{
+    for (; x < width; x += 2) {
+        size_t x1 = x + 1 < width ? x + 1 : x;
+        const uint8_t *a = &src0[x*4];
+        const uint8_t *b = &src0[x1*4];
+        const uint8_t *c = &src1[x*4];
+        const uint8_t *d = &src1[x1*4];
+
+        y0[x] = luma(a[0], a[1], a[2]);
+        if (x1 != x) y0[x1] = luma(b[0], b[1], b[2]);
+        if (y1) {
+            y1[x] = luma(c[0], c[1], c[2]);
+            if (x1 != x) y1[x1] = luma(d[0], d[1], d[2]);
+        }
+
+        int r = a[0] + b[0] + c[0] + d[0];
+        int g = a[1] + b[1] + c[1] + d[1];
+        int bl = a[2] + b[2] + c[2] + d[2];
+        u[x/2] = chroma_u(r, g, bl);
+        v[x/2] = chroma_v(r, g, bl);
+    }
+}
+
+#ifdef YUV_AVX2
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static inline __m256i channel(__m256i pixels, int shift)
+{
+    return _mm256_and_si256(_mm256_srli_epi32(pixels, shift), _mm256_set1_epi32(0xFF));
+}
+
+AVX2 static inline __m256i luma8(__m256i pixels)
+{
+    __m256i y = _mm256_add_epi32(
+        _mm256_add_epi32(
+            _mm256_mullo_epi32(channel(pixels, 0), _mm256_set1_epi32(66)),
+            _mm256_mullo_epi32(channel(pixels, 8), _mm256_set1_epi32(129))),
+        _mm256_add_epi32(
+            _mm256_mullo_epi32(channel(pixels, 16), _mm256_set1_epi32(25)),
+            _mm256_set1_epi32(128)));
+    return _mm256_add_epi32(_mm256_srli_epi32(y, 8), _mm256_set1_epi32(16));
+}
+
+// 16 luma values from two vectors of 8 int32
+AVX2 static inline void store_luma16(uint8_t *dst, __m256i a, __m256i b)
+{
+    __m256i t = _mm256_packs_epi32(luma8(a), luma8(b));
+    t = _mm256_permute4x64_epi64(t, 0xD8);
+    t = _mm256_packus_epi16(t, t);
+    __m128i bytes = _mm_unpacklo_epi64(_mm256_castsi256_si128(t), _mm256_extracti128_si256(t, 1));
+    _mm_storeu_si128((__m128i*)dst, bytes);
+}
+
+// Sums of the horizontally adjacent pairs of a and b, in order
+AVX2 static inline __m256i pair_sums(__m256i a, __m256i b)
+{
+    return _mm256_permute4x64_epi64(_mm256_hadd_epi32(a, b), 0xD8);
+}
+
+AVX2 static inline __m256i chroma8(__m256i r, __m256i g, __m256i b, int cr, int cg, int cb)
+{
+    __m256i c = _mm256_add_epi32(
+        _mm256_add_epi32(
+            _mm256_mullo_epi32(r, _mm256_set1_epi32(cr)),
+            _mm256_mullo_epi32(g, _mm256_set1_epi32(cg))),
+        _mm256_add_epi32(
+            _mm256_mullo_epi32(b, _mm256_set1_epi32(cb)),
+            _mm256_set1_epi32(512)));
+    return _mm256_add_epi32(_mm256_srai_epi32(c, 10), _mm256_set1_epi32(128));
+}
+
+// Converts 16 pixels at a time and returns where it stopped
+AVX2 static size_t convert_row_pair_avx2(const uint32_t *src0, const uint32_t *src1, size_t width,
+                                         uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v)
+{
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i p0 = _mm256_loadu_si256((const __m256i*)(src0 + x));
+        __m256i p1 = _mm256_loadu_si256((const __m256i*)(src0 + x + 8));
+        __m256i q0 = _mm256_loadu_si256((const __m256i*)(src1 + x));
+        __m256i q1 = _mm256_loadu_si256((const __m256i*)(src1 + x + 8));
+
+        store_luma16(y0 + x, p0, p1);
+        store_luma16(y1 + x, q0, q1);
+
+        __m256i r = pair_sums(_mm256_add_epi32(channel(p0, 0), channel(q0, 0)),
+                              _mm256_add_epi32(channel(p1, 0), channel(q1, 0)));
+        __m256i g = pair_sums(_mm256_add_epi32(channel(p0, 8), channel(q0, 8)),
+                              _mm256_add_epi32(channel(p1, 8), channel(q1, 8)));
+        __m256i b = pair_sums(_mm256_add_epi32(channel(p0, 16), channel(q0, 16)),
+                              _mm256_add_epi32(channel(p1, 16), channel(q1, 16)));
+
+        __m256i t = _mm256_packs_epi32(chroma8(r, g, b, -38, -74, 112), chroma8(r, g, b, 112, -94, -18));
+        t = _mm256_permute4x64_epi64(t, 0xD8);
+        t = _mm256_packus_epi16(t, t);
+        _mm_storel_epi64((__m128i*)(u + x/2), _mm256_castsi256_si128(t));
+        _mm_storel_epi64((__m128i*)(v + x/2), _mm256_extracti128_si256(t, 1));
+    }
+    return x;
+}
+
+static bool has_avx2(void)
+{
+    static int cached = -1;
+    if (cached < 0) cached = __builtin_cpu_supports("avx2") ? 1 : 0;
+    return cached;
+}
+#endif // YUV_AVX2
+
+void rgba_to_yuv420p_flipped(const void *rgba, size_t width, size_t height,
+                             size_t row_begin, size_t row_end, uint8_t *yuv)
+{
+    size_t chroma_width = (width + 1)/2;
+    size_t chroma_height = (height + 1)/2;
+    uint8_t *Y = yuv;
+    uint8_t *U = Y + width*height;
+    uint8_t *V = U + chroma_width*chroma_height;
+    const uint32_t *pixels = rgba;
+
+    if (row_end > height) row_end = height;
+    for (size_t row = row_begin; row < row_end; row += 2) {
+        bool has_next = row + 1 < height;
+        const uint32_t *src0 = pixels + (height - 1 - row)*width;
+        const uint32_t *src1 = has_next ? src0 - width : src0;
+        uint8_t *y0 = Y + row*width;
+        uint8_t *y1 = has_next ? y0 + width : NULL;
+        uint8_t *u = U + row/2*chroma_width;
+        uint8_t *v = V + row/2*chroma_width;
+
+        size_t x = 0;
+#ifdef YUV_AVX2
+        if (has_next && has_avx2()) x = convert_row_pair_avx2(src0, src1, width, y0, y1, u, v);
+#endif // YUV_AVX2
+        convert_row_pair_scalar((const uint8_t*)src0, (const uint8_t*)src1, width, x, y0, y1, u, v);
+    }
+}
@@ -0,0 +1,18 @@
+#ifndef YUV_H_
+#define YUV_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Size of a planar yuv420p frame: full resolution Y followed by quarter resolution U and V
+size_t yuv420p_size(size_t width, size_t height);
+
+// Converts bottom-up RGBA8 pixels (the way OpenGL reads them back) into a
+// top-down yuv420p frame (BT.601, limited range, the same as ffmpeg's default
+// for rgba -> yuv420p). Only the output rows [row_begin, row_end) are
+// produced, so the frame can be sliced between threads. row_begin must be
+// even. Uses AVX2 when the CPU has it.
+void rgba_to_yuv420p_flipped(const void *rgba, size_t width, size_t height,
+                             size_t row_begin, size_t row_end, uint8_t *yuv);
+
+#endif // YUV_H_
@@ -160,6 +160,9 @@ void plug_post_reload(void *state)
 
 void plug_update(Env env)
 {
+    // The editor has no animation to advance, all of its state comes from the input handled below
+    if (env.simulating) return;
+
     Color background_color = ColorFromHSV(0, 0, 0.05);
     Color foreground_color = ColorFromHSV(0, 0, 0.95);
 
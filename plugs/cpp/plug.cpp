@@ -178,6 +178,7 @@ void plug_post_reload(void *state)
 void plug_update(Env env)
 {
     p->finished = p->task->update(env);
+    if (env.simulating) return;
 
     Color background_color = ColorFromHSV(0, 0, 0.05);
     Color foreground_color = ColorFromHSV(0, 0, 0.95);
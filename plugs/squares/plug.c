@@ -12,6 +12,7 @@
 
 #define PLUG(name, ret, ...) ret name(__VA_ARGS__);
 LIST_OF_PLUGS
+LIST_OF_OPTIONAL_PLUGS
 #undef PLUG
 
 #define FONT_SIZE 68
@@ -35,7 +36,14 @@ typedef struct {
     Arena state_arena;
     Arena asset_arena;
     Square squares[SQUARES_COUNT];
+    Task_Pools task_pools;
     Task task;
+    // The task compiled into keys, so any point of the animation can be
+    // evaluated directly. Playing the task itself is the fallback if it
+    // can't be compiled.
+    Timeline timeline;
+    bool has_timeline;
+    float time;
     bool finished;
 } Plug;
 
@@ -55,6 +63,7 @@ static void load_assets(void)
     Arena *a = &p->asset_arena;
     arena_reset(a);
     task_vtable_rebuild(a);
+    task_pools = &p->task_pools;
 }
 
 static void unload_assets(void)
@@ -101,10 +110,13 @@ void plug_reset(void)
         p->squares[i].color = ColorNormalize(FOREGROUND_COLOR);
     }
     p->finished = false;
+    p->time = 0.0f;
     arena_reset(&p->state_arena);
+    memset(&p->task_pools, 0, sizeof(p->task_pools));
 
     Arena *a = &p->state_arena;
     p->task = loading(a);
+    p->has_timeline = timeline_compile(a, p->task, &p->timeline);
 }
 
 void plug_init(void)
@@ -138,7 +150,14 @@ void plug_post_reload(void *state)
 
 void plug_update(Env env)
 {
-    p->finished = task_update(p->task, env);
+    if (p->has_timeline) {
+        p->time += env.delta_time;
+        timeline_eval(&p->timeline, p->time);
+        p->finished = p->time >= p->timeline.duration;
+    } else {
+        p->finished = task_update(p->task, env);
+    }
+    if (env.simulating) return;
 
     ClearBackground(BACKGROUND_COLOR);
 
@@ -166,6 +185,23 @@ bool plug_finished(void)
     return p->finished;
 }
 
+// With the timeline the time is the whole state of the animation, everything
+// else is either fixed since plug_reset() or follows from it
+size_t plug_save(void *buffer, size_t size)
+{
+    if (!p->has_timeline) return 0;
+    if (size >= sizeof(p->time)) memcpy(buffer, &p->time, sizeof(p->time));
+    return sizeof(p->time);
+}
+
+void plug_load(const void *buffer, size_t size)
+{
+    assert(p->has_timeline && size == sizeof(p->time));
+    memcpy(&p->time, buffer, sizeof(p->time));
+    timeline_eval(&p->timeline, p->time);
+    p->finished = p->time >= p->timeline.duration;
+}
+
 #define ARENA_IMPLEMENTATION
 #include "arena.h"
 #include "tasks.c"
@@ -3,7 +3,16 @@
 
 #include "raymath.h"
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define TASKS_AVX2
+#include <immintrin.h>
+#endif
+
+// How many running moves are flushed at a time
+#define TASKS_FLUSH_BLOCK 256
+
 Task_VTable task_vtable = {0};
+Task_Pools *task_pools = NULL;
 Tag TASK_MOVE_SCALAR_TAG = 0;
 Tag TASK_MOVE_VEC2_TAG = 0;
 Tag TASK_MOVE_VEC4_TAG = 0;
@@ -11,9 +20,27 @@ Tag TASK_SEQ_TAG = 0;
 Tag TASK_GROUP_TAG = 0;
 Tag TASK_WAIT_TAG = 0;
 
+static bool pooled_wait_update(void *handle, Env env);
+static bool pooled_move_scalar_update(void *handle, Env env);
+static bool pooled_move_vec2_update(void *handle, Env env);
+static bool pooled_move_vec4_update(void *handle, Env env);
+static float pooled_wait_seek(void *handle, float t);
+static float pooled_move_scalar_seek(void *handle, float t);
+static float pooled_move_vec2_seek(void *handle, float t);
+static float pooled_move_vec4_seek(void *handle, float t);
+static float seq_seek(Seq_Data *data, float t);
+static float group_seek(Group_Data *data, float t);
+static bool task_update_child(Task task, Env env);
+static void task_pools_flush(Env env);
+
 bool task_update(Task task, Env env)
 {
-    return task_vtable.items[task.tag].update(task.data, env);
+    static size_t depth = 0;
+    depth += 1;
+    bool finished = task_update_child(task, env);
+    depth -= 1;
+    if (depth == 0) task_pools_flush(env);
+    return finished;
 }
 
 Tag task_vtable_register(Arena *a, Task_Funcs funcs)
@@ -28,22 +55,28 @@ void task_vtable_rebuild(Arena *a)
     memset(&task_vtable, 0, sizeof(task_vtable));
 
     TASK_WAIT_TAG = task_vtable_register(a, (Task_Funcs) {
-        .update = (task_update_data_t)wait_update,
+        .update = pooled_wait_update,
+        .seek = pooled_wait_seek,
     });
     TASK_MOVE_SCALAR_TAG = task_vtable_register(a, (Task_Funcs) {
-        .update = (task_update_data_t)move_scalar_update,
+        .update = pooled_move_scalar_update,
+        .seek = pooled_move_scalar_seek,
     });
     TASK_MOVE_VEC2_TAG = task_vtable_register(a, (Task_Funcs) {
-        .update = (task_update_data_t)move_vec2_update,
+        .update = pooled_move_vec2_update,
+        .seek = pooled_move_vec2_seek,
     });
     TASK_MOVE_VEC4_TAG = task_vtable_register(a, (Task_Funcs) {
-        .update = (task_update_data_t)move_vec4_update,
+        .update = pooled_move_vec4_update,
+        .seek = pooled_move_vec4_seek,
     });
     TASK_SEQ_TAG = task_vtable_register(a, (Task_Funcs) {
         .update = (task_update_data_t)seq_update,
+        .seek = (task_seek_data_t)seq_seek,
     });
     TASK_GROUP_TAG = task_vtable_register(a, (Task_Funcs) {
         .update = (task_update_data_t)group_update,
+        .seek = (task_seek_data_t)group_seek,
     });
 }
 
@@ -74,156 +107,586 @@ Wait_Data wait_data(float duration)
     return (Wait_Data) { .duration = duration };
 }
 
+static void *pool_handle(size_t index)
+{
+    return (void*)(uintptr_t)(index + 1);
+}
+
+static size_t pool_index(void *handle)
+{
+    return (uintptr_t)handle - 1;
+}
+
+#define pool_grow_array(a, array, capacity, new_capacity) \
+    (array) = arena_realloc((a), (array), (capacity)*sizeof(*(array)), (new_capacity)*sizeof(*(array)))
+
+static bool pooled_wait_update(void *handle, Env env)
+{
+    Wait_Pool *pool = &task_pools->wait;
+    size_t i = pool_index(handle);
+    if (pool->cursor[i] >= pool->duration[i]) return true;
+    pool->cursor[i] += env.delta_time;
+    return pool->cursor[i] >= pool->duration[i];
+}
+
 Task task_wait(Arena *a, float duration)
 {
-    Wait_Data data = wait_data(duration);
+    assert(task_pools != NULL && "task_pools is not set");
+    Wait_Pool *pool = &task_pools->wait;
+    if (pool->count >= pool->capacity) {
+        size_t new_capacity = pool->capacity == 0 ? ARENA_DA_INIT_CAP : pool->capacity*2;
+        pool_grow_array(a, pool->cursor, pool->capacity, new_capacity);
+        pool_grow_array(a, pool->duration, pool->capacity, new_capacity);
+        pool->capacity = new_capacity;
+    }
+    size_t i = pool->count++;
+    pool->cursor[i] = 0.0f;
+    pool->duration[i] = duration;
     return (Task) {
         .tag = TASK_WAIT_TAG,
-        .data = arena_memdup(a, &data, sizeof(data)),
+        .data = pool_handle(i),
     };
 }
 
-bool move_scalar_update(Move_Scalar_Data *data, Env env)
+// The planes of the running moves are capacity floats apart, so they are
+// spread out again whenever the pool grows
+static float *grow_planes(Arena *a, float *planes, size_t components, size_t capacity, size_t new_capacity, size_t count)
 {
-    if (wait_done(&data->wait)) return true;
+    float *result = arena_alloc(a, sizeof(float)*components*new_capacity);
+    if (count > 0) {
+        for (size_t c = 0; c < components; ++c) {
+            memcpy(result + c*new_capacity, planes + c*capacity, sizeof(float)*count);
+        }
+    }
+    return result;
+}
 
-    if (!data->wait.started && data->value) {
-        data->start = *data->value;
+static Task move_pool_add(Arena *a, Move_Pool *pool, Tag tag, float *value, const float *target, size_t components, float duration, Interp_Func func)
+{
+    assert(task_pools != NULL && "task_pools is not set");
+    pool->components = components;
+    if (pool->count >= pool->capacity) {
+        size_t capacity = pool->capacity;
+        size_t new_capacity = capacity == 0 ? ARENA_DA_INIT_CAP : capacity*2;
+        pool_grow_array(a, pool->value, capacity, new_capacity);
+        pool_grow_array(a, pool->target, capacity*components, new_capacity*components);
+        pool_grow_array(a, pool->duration, capacity, new_capacity);
+        pool_grow_array(a, pool->func, capacity, new_capacity);
+        pool_grow_array(a, pool->state, capacity, new_capacity);
+        pool_grow_array(a, pool->slot, capacity, new_capacity);
+        pool_grow_array(a, pool->started, capacity, new_capacity);
+        pool_grow_array(a, pool->from, capacity*components, new_capacity*components);
+
+        // Every move may be running at the same time
+        pool_grow_array(a, pool->running.move, capacity, new_capacity);
+        pool_grow_array(a, pool->running.value, capacity, new_capacity);
+        pool_grow_array(a, pool->running.cursor, capacity, new_capacity);
+        pool_grow_array(a, pool->running.duration, capacity, new_capacity);
+        pool_grow_array(a, pool->running.func, capacity, new_capacity);
+        pool_grow_array(a, pool->running.visited, capacity, new_capacity);
+        pool_grow_array(a, pool->running.finished, capacity, new_capacity);
+        size_t count = pool->running.count;
+        pool->running.start = grow_planes(a, pool->running.start, components, capacity, new_capacity, count);
+        pool->running.target = grow_planes(a, pool->running.target, components, capacity, new_capacity, count);
+
+        pool->capacity = new_capacity;
     }
 
-    bool finished = wait_update(&data->wait, env);
+    size_t i = pool->count++;
+    pool->value[i] = value;
+    memcpy(pool->target + i*components, target, sizeof(float)*components);
+    pool->duration[i] = duration;
+    pool->func[i] = func;
+    pool->state[i] = MOVE_IDLE;
+    pool->started[i] = false;
+    return (Task) {
+        .tag = tag,
+        .data = pool_handle(i),
+    };
+}
 
-    if (data->value) {
-        *data->value = Lerp(
-            data->start,
-            data->target,
-            interp_func(data->func, wait_interp(&data->wait)));
+// interp_func(func, wait_interp()) of every running move
+static void ease_scalar(const float *cursor, const float *duration, const Interp_Func *func, float *progress, size_t count)
+{
+    for (size_t j = 0; j < count; ++j) {
+        float t = 0.0f;
+        if (duration[j] > 0) t = cursor[j]/duration[j];
+        progress[j] = interp_func(func[j], t);
     }
+}
 
-    return finished;
+// The same as Lerp() of raymath for every component
+static void lerp_scalar(const float *start, const float *target, const float *t, float *result, size_t count)
+{
+    for (size_t j = 0; j < count; ++j) result[j] = start[j] + t[j]*(target[j] - start[j]);
 }
 
-Move_Scalar_Data move_scalar_data(float *value, float target, float duration, Interp_Func func)
+// Takes a running slot for the move. It starts from wherever its value is
+// now, unless task_seek() already found out where it starts from.
+static void move_pool_start(Move_Pool *pool, size_t i, float cursor)
 {
-    return (Move_Scalar_Data) {
-        .wait = wait_data(duration),
-        .value = value,
-        .target = target,
-        .func = func,
-    };
+    size_t components = pool->components;
+    float *from = pool->from + i*components;
+    if (!pool->started[i]) {
+        for (size_t c = 0; c < components; ++c) from[c] = pool->value[i] ? pool->value[i][c] : 0.0f;
+        pool->started[i] = true;
+    }
+
+    size_t j = pool->running.count++;
+    size_t capacity = pool->capacity;
+    pool->running.move[j] = i;
+    pool->running.value[j] = pool->value[i];
+    pool->running.cursor[j] = cursor;
+    pool->running.duration[j] = pool->duration[i];
+    pool->running.func[j] = pool->func[i];
+    pool->running.visited[j] = false;
+    for (size_t c = 0; c < components; ++c) {
+        pool->running.start[c*capacity + j] = from[c];
+        pool->running.target[c*capacity + j] = pool->target[i*components + c];
+    }
+    pool->slot[i] = j;
+    pool->state[i] = MOVE_RUNNING;
+}
+
+// The walk over the tree only decides whether the move finishes in this
+// frame. Moving the value is left to move_pool_flush(), except for the
+// moves that finish.
+static bool move_pool_update(Move_Pool *pool, size_t i, float delta_time)
+{
+    if (pool->state[i] == MOVE_DONE) return true;
+
+    if (pool->state[i] == MOVE_IDLE) {
+        // A move without duration is done before it has even started
+        if (pool->duration[i] <= 0) {
+            pool->state[i] = MOVE_DONE;
+            return true;
+        }
+        move_pool_start(pool, i, 0.0f);
+    }
+
+    size_t j = pool->slot[i];
+    pool->running.visited[j] = true;
+    if (pool->running.cursor[j] + delta_time < pool->running.duration[j]) return false;
+
+    // A move that starts later in the walk may pick up where this one ends,
+    // so the end value can't wait for move_pool_flush(). It writes the very
+    // same value there once more.
+    float *value = pool->running.value[j];
+    if (value) {
+        size_t capacity = pool->capacity;
+        float cursor = pool->running.cursor[j] + delta_time;
+        float progress;
+        ease_scalar(&cursor, &pool->running.duration[j], &pool->running.func[j], &progress, 1);
+        for (size_t c = 0; c < pool->components; ++c) {
+            lerp_scalar(&pool->running.start[c*capacity + j], &pool->running.target[c*capacity + j], &progress, &value[c], 1);
+        }
+    }
+    return true;
+}
+
+static bool pooled_move_scalar_update(void *handle, Env env)
+{
+    return move_pool_update(&task_pools->move_scalar, pool_index(handle), env.delta_time);
+}
+
+static bool pooled_move_vec2_update(void *handle, Env env)
+{
+    return move_pool_update(&task_pools->move_vec2, pool_index(handle), env.delta_time);
+}
+
+static bool pooled_move_vec4_update(void *handle, Env env)
+{
+    return move_pool_update(&task_pools->move_vec4, pool_index(handle), env.delta_time);
 }
 
 Task task_move_scalar(Arena *a, float *value, float target, float duration, Interp_Func func)
 {
-    Move_Scalar_Data data = move_scalar_data(value, target, duration, func);
-    return (Task) {
-        .tag = TASK_MOVE_SCALAR_TAG,
-        .data = arena_memdup(a, &data, sizeof(data)),
-    };
+    return move_pool_add(a, &task_pools->move_scalar, TASK_MOVE_SCALAR_TAG, value, &target, 1, duration, func);
+}
+
+Task task_move_vec2(Arena *a, Vector2 *value, Vector2 target, float duration, Interp_Func func)
+{
+    return move_pool_add(a, &task_pools->move_vec2, TASK_MOVE_VEC2_TAG, (float*)value, (float*)&target, 2, duration, func);
 }
 
-bool move_vec2_update(Move_Vec2_Data *data, Env env)
+Task task_move_vec4(Arena *a, Vector4 *value, Vector4 target, float duration, Interp_Func func)
 {
-    if (wait_done(&data->wait)) return true;
+    return move_pool_add(a, &task_pools->move_vec4, TASK_MOVE_VEC4_TAG, (float*)value, (float*)&target, 4, duration, func);
+}
+
+#ifdef TASKS_AVX2
+// Gives exactly the same results as ease_scalar()
+__attribute__((target("avx2")))
+static void ease_avx2(const float *cursor, const float *duration, const Interp_Func *func, float *progress, size_t count)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 three = _mm256_set1_ps(3.0f);
+    size_t j = 0;
+    for (; j + 8 <= count; j += 8) {
+        __m256 d = _mm256_loadu_ps(duration + j);
+        __m256i f = _mm256_loadu_si256((const __m256i*)(func + j));
+
+        // The lanes without duration get 0/0, which the mask turns into 0
+        __m256 t = _mm256_and_ps(_mm256_div_ps(_mm256_loadu_ps(cursor + j), d), _mm256_cmp_ps(d, zero, _CMP_GT_OQ));
+
+        __m256 sqr = _mm256_mul_ps(t, t);
+        __m256 root = _mm256_sqrt_ps(t);
+        __m256 smooth = _mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(three, t), t),
+                                      _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(two, t), t), t));
+        smooth = _mm256_blendv_ps(smooth, zero, _mm256_cmp_ps(t, zero, _CMP_LT_OQ));
+        smooth = _mm256_blendv_ps(smooth, one, _mm256_cmp_ps(t, one, _CMP_GE_OQ));
+
+        __m256i is_id = _mm256_cmpeq_epi32(f, _mm256_set1_epi32(FUNC_ID));
+        __m256i is_sqr = _mm256_cmpeq_epi32(f, _mm256_set1_epi32(FUNC_SQR));
+        __m256i is_sqrt = _mm256_cmpeq_epi32(f, _mm256_set1_epi32(FUNC_SQRT));
+        __m256i is_smooth = _mm256_cmpeq_epi32(f, _mm256_set1_epi32(FUNC_SMOOTHSTEP));
+
+        __m256 result = t;
+        result = _mm256_blendv_ps(result, sqr, _mm256_castsi256_ps(is_sqr));
+        result = _mm256_blendv_ps(result, root, _mm256_castsi256_ps(is_sqrt));
+        result = _mm256_blendv_ps(result, smooth, _mm256_castsi256_ps(is_smooth));
+        _mm256_storeu_ps(progress + j, result);
+
+        // Every other func (there is no vector sinf() for the sine ones) goes
+        // through interp_func() one lane at a time, so a func added to
+        // Interp_Func is never mistaken for linear here
+        __m256i vector = _mm256_or_si256(_mm256_or_si256(is_id, is_sqr), _mm256_or_si256(is_sqrt, is_smooth));
+        int lanes = ~_mm256_movemask_ps(_mm256_castsi256_ps(vector)) & 0xFF;
+        if (lanes != 0) {
+            float ts[8];
+            _mm256_storeu_ps(ts, t);
+            while (lanes != 0) {
+                int lane = __builtin_ctz(lanes);
+                lanes &= lanes - 1;
+                progress[j + lane] = interp_func(func[j + lane], ts[lane]);
+            }
+        }
+    }
+    ease_scalar(cursor + j, duration + j, func + j, progress + j, count - j);
+}
 
-    if (!data->wait.started && data->value) {
-        data->start = *data->value;
+__attribute__((target("avx2")))
+static void lerp_avx2(const float *start, const float *target, const float *t, float *result, size_t count)
+{
+    size_t j = 0;
+    for (; j + 8 <= count; j += 8) {
+        __m256 s = _mm256_loadu_ps(start + j);
+        __m256 d = _mm256_sub_ps(_mm256_loadu_ps(target + j), s);
+        _mm256_storeu_ps(result + j, _mm256_add_ps(s, _mm256_mul_ps(_mm256_loadu_ps(t + j), d)));
     }
+    lerp_scalar(start + j, target + j, t + j, result + j, count - j);
+}
 
-    bool finished = wait_update(&data->wait, env);
+static bool has_avx2(void)
+{
+    static int cached = -1;
+    if (cached < 0) cached = __builtin_cpu_supports("avx2") ? 1 : 0;
+    return cached;
+}
+#endif // TASKS_AVX2
 
-    if (data->value) {
-        *data->value = Vector2Lerp(
-            data->start,
-            data->target,
-            interp_func(data->func, wait_interp(&data->wait)));
+static void ease(const float *cursor, const float *duration, const Interp_Func *func, float *progress, size_t count)
+{
+#ifdef TASKS_AVX2
+    if (has_avx2()) {
+        ease_avx2(cursor, duration, func, progress, count);
+        return;
     }
-    return finished;
+#endif // TASKS_AVX2
+    ease_scalar(cursor, duration, func, progress, count);
 }
 
-Move_Vec2_Data move_vec2_data(Vector2 *value, Vector2 target, float duration, Interp_Func func)
+static void lerp(const float *start, const float *target, const float *t, float *result, size_t count)
 {
-    return (Move_Vec2_Data) {
-        .wait = wait_data(duration),
-        .value = value,
-        .target = target,
-        .func = func,
-    };
+#ifdef TASKS_AVX2
+    if (has_avx2()) {
+        lerp_avx2(start, target, t, result, count);
+        return;
+    }
+#endif // TASKS_AVX2
+    lerp_scalar(start, target, t, result, count);
 }
 
-Task task_move_vec2(Arena *a, Vector2 *value, Vector2 target, float duration, Interp_Func func)
+// Drops the given slots, which are in increasing order. The moves that keep
+// running stay in the order they started, so when two of them move the same
+// value it's the one that started last that wins.
+static void move_pool_compact(Move_Pool *pool, size_t finished)
 {
-    Move_Vec2_Data data = move_vec2_data(value, target, duration, func);
-    return (Task) {
-        .tag = TASK_MOVE_VEC2_TAG,
-        .data = arena_memdup(a, &data, sizeof(data)),
-    };
+    size_t capacity = pool->capacity;
+    size_t f = 0;
+    size_t w = pool->running.finished[0];
+    for (size_t j = w; j < pool->running.count; ++j) {
+        if (f < finished && pool->running.finished[f] == j) {
+            f += 1;
+            continue;
+        }
+        pool->running.move[w] = pool->running.move[j];
+        pool->running.value[w] = pool->running.value[j];
+        pool->running.cursor[w] = pool->running.cursor[j];
+        pool->running.duration[w] = pool->running.duration[j];
+        pool->running.func[w] = pool->running.func[j];
+        pool->running.visited[w] = pool->running.visited[j];
+        for (size_t c = 0; c < pool->components; ++c) {
+            pool->running.start[c*capacity + w] = pool->running.start[c*capacity + j];
+            pool->running.target[c*capacity + w] = pool->running.target[c*capacity + j];
+        }
+        pool->slot[pool->running.move[w]] = w;
+        w += 1;
+    }
+    pool->running.count = w;
+}
+
+// Only the moves visited by the walk advance, just like they would if each
+// of them was updated on its own. The running moves are processed a block at
+// a time, so all the passes over a block happen while it is still in the cache.
+static void move_pool_flush(Move_Pool *pool, float delta_time)
+{
+    size_t count = pool->running.count;
+    size_t capacity = pool->capacity;
+    size_t components = pool->components;
+    size_t finished = 0;
+
+    float progress[TASKS_FLUSH_BLOCK];
+    float result[4][TASKS_FLUSH_BLOCK];
+    assert(components <= sizeof(result)/sizeof(result[0]));
+
+    for (size_t base = 0; base < count; base += TASKS_FLUSH_BLOCK) {
+        size_t n = count - base < TASKS_FLUSH_BLOCK ? count - base : TASKS_FLUSH_BLOCK;
+        float *cursor = pool->running.cursor + base;
+        const float *duration = pool->running.duration + base;
+        bool *visited = pool->running.visited + base;
+
+        for (size_t j = 0; j < n; ++j) {
+            if (visited[j]) cursor[j] += delta_time;
+        }
+        ease(cursor, duration, pool->running.func + base, progress, n);
+        for (size_t c = 0; c < components; ++c) {
+            lerp(pool->running.start + c*capacity + base, pool->running.target + c*capacity + base, progress, result[c], n);
+        }
+
+        for (size_t j = 0; j < n; ++j) {
+            if (!visited[j]) continue;
+            visited[j] = false;
+            float *value = pool->running.value[base + j];
+            if (value) {
+                for (size_t c = 0; c < components; ++c) value[c] = result[c][j];
+            }
+            if (cursor[j] >= duration[j]) {
+                pool->state[pool->running.move[base + j]] = MOVE_DONE;
+                pool->running.finished[finished++] = base + j;
+            }
+        }
+    }
+
+    if (finished > 0) move_pool_compact(pool, finished);
+}
+
+// Groups and sequences update their children through here. The pooled kinds
+// are so cheap to update that going through the vtable would cost more than
+// the update itself.
+static bool task_update_child(Task task, Env env)
+{
+    if (task.tag == TASK_MOVE_SCALAR_TAG) return move_pool_update(&task_pools->move_scalar, pool_index(task.data), env.delta_time);
+    if (task.tag == TASK_MOVE_VEC2_TAG) return move_pool_update(&task_pools->move_vec2, pool_index(task.data), env.delta_time);
+    if (task.tag == TASK_MOVE_VEC4_TAG) return move_pool_update(&task_pools->move_vec4, pool_index(task.data), env.delta_time);
+    return task_vtable.items[task.tag].update(task.data, env);
 }
 
-bool move_vec4_update(Move_Vec4_Data *data, Env env)
+static void task_pools_flush(Env env)
 {
-    if (wait_done(&data->wait)) return true;
+    if (task_pools == NULL) return;
+    move_pool_flush(&task_pools->move_scalar, env.delta_time);
+    move_pool_flush(&task_pools->move_vec2, env.delta_time);
+    move_pool_flush(&task_pools->move_vec4, env.delta_time);
+}
 
-    if (!data->wait.started && data->value) {
-        data->start = *data->value;
+static float pooled_wait_seek(void *handle, float t)
+{
+    Wait_Pool *pool = &task_pools->wait;
+    size_t i = pool_index(handle);
+    float duration = pool->duration[i] > 0 ? pool->duration[i] : 0;
+    if (t < 0) pool->cursor[i] = 0.0f;
+    else pool->cursor[i] = t < duration ? t : duration;
+    return duration;
+}
+
+// The rewind leaves the move idle and task_seek() takes its slot back before
+// seeking forward. It also takes back the slots of the moves that turn out to
+// be done at the end.
+static float move_pool_seek(Move_Pool *pool, size_t i, float t)
+{
+    size_t components = pool->components;
+    float duration = pool->duration[i] > 0 ? pool->duration[i] : 0;
+    float *value = pool->value[i];
+
+    if (t < 0) {
+        if (pool->started[i] && value) memcpy(value, pool->from + i*components, sizeof(float)*components);
+        pool->started[i] = false;
+        pool->state[i] = MOVE_IDLE;
+        return duration;
     }
 
-    bool finished = wait_update(&data->wait, env);
+    if (duration <= 0) {
+        pool->state[i] = MOVE_DONE;
+        return duration;
+    }
 
-    if (data->value) {
-        *data->value = QuaternionLerp(
-            data->start,
-            data->target,
-            interp_func(data->func, wait_interp(&data->wait)));
+    if (pool->state[i] != MOVE_RUNNING) move_pool_start(pool, i, 0.0f);
+    pool->running.cursor[pool->slot[i]] = t < duration ? t : duration;
+    float x = t < duration ? t/duration : 1.0f;
+    float progress = interp_func(pool->func[i], x);
+    if (value) {
+        for (size_t c = 0; c < components; ++c) {
+            value[c] = Lerp(pool->from[i*components + c], pool->target[i*components + c], progress);
+        }
     }
 
-    return finished;
+    if (t >= duration) pool->state[i] = MOVE_DONE;
+    return duration;
 }
 
-Move_Vec4_Data move_vec4_data(Vector4 *value, Vector4 target, float duration, Interp_Func func)
+// Drops the slots of the moves that are not running anymore. Outside of
+// task_seek() every slot belongs to a running move, so the slots of the
+// other trees are left alone.
+static void move_pool_drop_stopped(Move_Pool *pool)
 {
-    return (Move_Vec4_Data) {
-        .wait = wait_data(duration),
-        .value = value,
-        .target = target,
-        .func = func,
-    };
+    size_t finished = 0;
+    for (size_t j = 0; j < pool->running.count; ++j) {
+        if (pool->state[pool->running.move[j]] != MOVE_RUNNING) pool->running.finished[finished++] = j;
+    }
+    if (finished > 0) move_pool_compact(pool, finished);
 }
 
-Task task_move_vec4(Arena *a, Vector4 *value, Vector4 target, float duration, Interp_Func func)
+static float pooled_move_scalar_seek(void *handle, float t)
 {
-    Move_Vec4_Data data = move_vec4_data(value, target, duration, func);
-    return (Task) {
-        .tag = TASK_MOVE_VEC4_TAG,
-        .data = arena_memdup(a, &data, sizeof(data)),
-    };
+    return move_pool_seek(&task_pools->move_scalar, pool_index(handle), t);
+}
+
+static float pooled_move_vec2_seek(void *handle, float t)
+{
+    return move_pool_seek(&task_pools->move_vec2, pool_index(handle), t);
+}
+
+static float pooled_move_vec4_seek(void *handle, float t)
+{
+    return move_pool_seek(&task_pools->move_vec4, pool_index(handle), t);
+}
+
+static void task_pools_drop_stopped(void)
+{
+    if (task_pools == NULL) return;
+    move_pool_drop_stopped(&task_pools->move_scalar);
+    move_pool_drop_stopped(&task_pools->move_vec2);
+    move_pool_drop_stopped(&task_pools->move_vec4);
+}
+
+static float task_seek_child(Task task, float t)
+{
+    return task_vtable.items[task.tag].seek(task.data, t);
+}
+
+static bool task_can_seek(Task task)
+{
+    if (task_vtable.items[task.tag].seek == NULL) {
+        TraceLog(LOG_ERROR, "TASKS: task with tag %zu can't seek", task.tag);
+        return false;
+    }
+    if (task.tag == TASK_SEQ_TAG || task.tag == TASK_GROUP_TAG) {
+        // Seq_Data and Group_Data both start with their Tasks
+        Tasks *tasks = task.data;
+        for (size_t i = 0; i < tasks->count; ++i) {
+            if (!task_can_seek(tasks->items[i])) return false;
+        }
+    }
+    return true;
+}
+
+bool task_seek(Task task, float t)
+{
+    if (!task_can_seek(task)) return false;
+
+    task_seek_child(task, -1.0f);
+    task_pools_drop_stopped();
+    if (t >= 0) {
+        task_seek_child(task, t);
+        task_pools_drop_stopped();
+    }
+    return true;
 }
 
 bool group_update(Group_Data *data, Env env)
 {
-    bool finished = true;
-    for (size_t i = 0; i < data->tasks.count; ++i) {
-        Task it = data->tasks.items[i];
-        if (!task_update(it, env)) {
-            finished = false;
+    size_t active_count = 0;
+    for (size_t i = 0; i < data->active_count; ++i) {
+        uint32_t child = data->active[i];
+        if (!task_update_child(data->tasks.items[child], env)) {
+            data->active[active_count++] = child;
         }
     }
-    return finished;
+    data->active_count = active_count;
+    return active_count == 0;
+}
+
+static float group_seek(Group_Data *data, float t)
+{
+    if (t < 0) {
+        data->duration = 0.0f;
+        for (size_t i = data->tasks.count; i > 0; --i) {
+            float duration = task_seek_child(data->tasks.items[i - 1], t);
+            if (duration > data->duration) data->duration = duration;
+        }
+        for (size_t i = 0; i < data->tasks.count; ++i) data->active[i] = i;
+        data->active_count = data->tasks.count;
+        return data->duration;
+    }
+
+    // All the children start together, so they all have to find out where
+    // they start from before any of them moves on
+    if (t > 0) {
+        for (size_t i = 0; i < data->tasks.count; ++i) {
+            task_seek_child(data->tasks.items[i], 0.0f);
+        }
+    }
+    data->active_count = 0;
+    for (size_t i = 0; i < data->tasks.count; ++i) {
+        if (t < task_seek_child(data->tasks.items[i], t)) data->active[data->active_count++] = i;
+    }
+    return data->duration;
+}
+
+// The children are constructed before the arguments are passed, so each one
+// is already in the arena right in front of its parent. The parent puts its
+// data and the list of its children into a single block of exactly the size
+// they need, which keeps the whole tree packed depth first.
+static size_t count_tasks(va_list args)
+{
+    size_t count = 0;
+    while (va_arg(args, Task).data != NULL) count += 1;
+    return count;
 }
 
 Task task_group_(Arena *a, ...)
 {
-    Group_Data *data = (Group_Data*)arena_alloc(a, sizeof(*data));
+    va_list args;
+    va_start(args, a);
+    size_t count = count_tasks(args);
+    va_end(args);
+
+    Group_Data *data = (Group_Data*)arena_alloc(a, sizeof(*data) + (sizeof(Task) + sizeof(*data->active))*count);
     memset(data, 0, sizeof(*data));
+    data->tasks.items = (Task*)(data + 1);
+    data->tasks.capacity = count;
+    data->active = (uint32_t*)(data->tasks.items + count);
 
-    va_list args;
     va_start(args, a);
-    for (;;) {
-        Task task = va_arg(args, Task);
-        if (task.data == NULL) break;
-        arena_da_append(a, &data->tasks, task);
-    }
+    for (size_t i = 0; i < count; ++i) data->tasks.items[i] = va_arg(args, Task);
     va_end(args);
+    data->tasks.count = count;
+
+    for (size_t i = 0; i < count; ++i) data->active[i] = i;
+    data->active_count = count;
 
     return (Task) {
         .tag = TASK_GROUP_TAG,
@@ -236,29 +699,269 @@ bool seq_update(Seq_Data *data, Env env)
     if (data->it >= data->tasks.count) return true;
 
     Task it = data->tasks.items[data->it];
-    if (task_update(it, env)) {
+    if (task_update_child(it, env)) {
         data->it += 1;
     }
 
     return data->it >= data->tasks.count;
 }
 
+// Going back happens last to first, so the values end up as they were
+// before the first task changed them
+static float seq_seek(Seq_Data *data, float t)
+{
+    if (t < 0) {
+        data->it = 0;
+        data->duration = 0.0f;
+        for (size_t i = data->tasks.count; i > 0; --i) {
+            data->duration += task_seek_child(data->tasks.items[i - 1], t);
+        }
+        return data->duration;
+    }
+
+    float start = 0.0f;
+    for (data->it = 0; data->it < data->tasks.count; ++data->it) {
+        float duration = task_seek_child(data->tasks.items[data->it], t - start);
+        if (t - start < duration) break;
+        start += duration;
+    }
+    return data->duration;
+}
+
 Task task_seq_(Arena *a, ...)
 {
-    Seq_Data *data = (Seq_Data*)arena_alloc(a, sizeof(*data));
+    va_list args;
+    va_start(args, a);
+    size_t count = count_tasks(args);
+    va_end(args);
+
+    Seq_Data *data = (Seq_Data*)arena_alloc(a, sizeof(*data) + sizeof(Task)*count);
     memset(data, 0, sizeof(*data));
+    data->tasks.items = (Task*)(data + 1);
+    data->tasks.capacity = count;
 
-    va_list args;
     va_start(args, a);
-    for (;;) {
-        Task task = va_arg(args, Task);
-        if (task.data == NULL) break;
-        arena_da_append(a, &data->tasks, task);
-    }
+    for (size_t i = 0; i < count; ++i) data->tasks.items[i] = va_arg(args, Task);
     va_end(args);
+    data->tasks.count = count;
 
     return (Task) {
         .tag = TASK_SEQ_TAG,
         .data = data,
     };
 }
+
+size_t task_count(Task task)
+{
+    size_t count = 1;
+    if (task.tag == TASK_SEQ_TAG || task.tag == TASK_GROUP_TAG) {
+        // Seq_Data and Group_Data both start with their Tasks
+        Tasks *tasks = task.data;
+        for (size_t i = 0; i < tasks->count; ++i) count += task_count(tasks->items[i]);
+    }
+    return count;
+}
+
+typedef struct {
+    float *value;
+    size_t components;
+    // Where the move is in the tree, so the sort keeps the keys that start
+    // at the same time in the order the runtime would have run them
+    size_t order;
+    Timeline_Key key;
+} Timeline_Entry;
+
+typedef struct {
+    Timeline_Entry *items;
+    size_t count;
+    size_t capacity;
+} Timeline_Entries;
+
+static void timeline_collect_move(Arena *a, Timeline_Entries *entries, Move_Pool *pool, size_t i, float start, float *end)
+{
+    float duration = pool->duration[i];
+    // Such moves finish without ever touching their value
+    if (duration <= 0 || pool->value[i] == NULL) {
+        *end = start;
+        return;
+    }
+
+    Timeline_Entry entry = {
+        .value = pool->value[i],
+        .components = pool->components,
+        .order = entries->count,
+        .key = {
+            .start = start,
+            .end = start + duration,
+            .func = pool->func[i],
+        },
+    };
+    memcpy(entry.key.to, pool->target + i*pool->components, sizeof(float)*pool->components);
+    arena_da_append(a, entries, entry);
+    *end = entry.key.end;
+}
+
+static bool timeline_collect(Arena *a, Timeline_Entries *entries, Task task, float start, float *end)
+{
+    if (task.tag == TASK_WAIT_TAG) {
+        float duration = task_pools->wait.duration[pool_index(task.data)];
+        *end = start + (duration > 0 ? duration : 0);
+        return true;
+    }
+    if (task.tag == TASK_MOVE_SCALAR_TAG) {
+        timeline_collect_move(a, entries, &task_pools->move_scalar, pool_index(task.data), start, end);
+        return true;
+    }
+    if (task.tag == TASK_MOVE_VEC2_TAG) {
+        timeline_collect_move(a, entries, &task_pools->move_vec2, pool_index(task.data), start, end);
+        return true;
+    }
+    if (task.tag == TASK_MOVE_VEC4_TAG) {
+        timeline_collect_move(a, entries, &task_pools->move_vec4, pool_index(task.data), start, end);
+        return true;
+    }
+    if (task.tag == TASK_SEQ_TAG) {
+        Seq_Data *data = task.data;
+        *end = start;
+        for (size_t i = 0; i < data->tasks.count; ++i) {
+            if (!timeline_collect(a, entries, data->tasks.items[i], *end, end)) return false;
+        }
+        return true;
+    }
+    if (task.tag == TASK_GROUP_TAG) {
+        Group_Data *data = task.data;
+        *end = start;
+        for (size_t i = 0; i < data->tasks.count; ++i) {
+            float child_end = start;
+            if (!timeline_collect(a, entries, data->tasks.items[i], start, &child_end)) return false;
+            if (child_end > *end) *end = child_end;
+        }
+        return true;
+    }
+
+    TraceLog(LOG_ERROR, "TASKS: can't compile task with tag %zu into a timeline", task.tag);
+    return false;
+}
+
+static int timeline_entry_compare(const void *a, const void *b)
+{
+    const Timeline_Entry *x = a;
+    const Timeline_Entry *y = b;
+    if ((uintptr_t)x->value != (uintptr_t)y->value) return (uintptr_t)x->value < (uintptr_t)y->value ? -1 : 1;
+    if (x->components != y->components) return x->components < y->components ? -1 : 1;
+    if (x->key.start != y->key.start) return x->key.start < y->key.start ? -1 : 1;
+    if (x->order != y->order) return x->order < y->order ? -1 : 1;
+    return 0;
+}
+
+static bool timeline_same_track(const Timeline_Entry *a, const Timeline_Entry *b)
+{
+    return a->value == b->value && a->components == b->components;
+}
+
+static int timeline_track_compare(const void *a, const void *b)
+{
+    const Timeline_Track *x = a;
+    const Timeline_Track *y = b;
+    if (x->keys[0].start != y->keys[0].start) return x->keys[0].start < y->keys[0].start ? -1 : 1;
+    return 0;
+}
+
+static void timeline_key_eval(const Timeline_Key *key, size_t components, float t, float *value)
+{
+    // Not just to after the end, a pulse comes back to from
+    float x = (t - key->start)/(key->end - key->start);
+    if (x > 1.0f) x = 1.0f;
+    float progress = interp_func(key->func, x);
+    for (size_t c = 0; c < components; ++c) {
+        value[c] = Lerp(key->from[c], key->to[c], progress);
+    }
+}
+
+// The key that puts the value into its state at time t out of the first
+// count keys of a track, that is the last one to start of those that are
+// still running at t. The runtime writes the running moves in the order they
+// started, the one that finishes at t included. If none of them is running
+// anymore, it's the one that ended last.
+static const Timeline_Key *timeline_winner(const Timeline_Key *keys, size_t count, float t)
+{
+    const Timeline_Key *last = &keys[keys[count - 1].ends_last];
+    if (last->end < t) return last;
+    size_t i = count - 1;
+    while (keys[i].end < t) i -= 1;
+    return &keys[i];
+}
+
+bool timeline_compile(Arena *a, Task task, Timeline *timeline)
+{
+    memset(timeline, 0, sizeof(*timeline));
+
+    Arena scratch = {0};
+    Timeline_Entries entries = {0};
+    float end = 0.0f;
+    if (!timeline_collect(&scratch, &entries, task, 0.0f, &end)) {
+        arena_free(&scratch);
+        return false;
+    }
+    timeline->duration = end;
+
+    // Brings the keys of every value next to each other
+    if (entries.count > 0) qsort(entries.items, entries.count, sizeof(*entries.items), timeline_entry_compare);
+
+    for (size_t i = 0; i < entries.count; ++i) {
+        if (i == 0 || !timeline_same_track(&entries.items[i - 1], &entries.items[i])) timeline->tracks_count += 1;
+    }
+    timeline->keys_count = entries.count;
+    timeline->keys = arena_alloc(a, sizeof(*timeline->keys)*timeline->keys_count);
+    timeline->tracks = arena_alloc(a, sizeof(*timeline->tracks)*timeline->tracks_count);
+
+    Timeline_Track *track = NULL;
+    for (size_t i = 0; i < entries.count; ++i) {
+        Timeline_Entry *entry = &entries.items[i];
+        Timeline_Key *key = &timeline->keys[i];
+        *key = entry->key;
+        if (i == 0 || !timeline_same_track(entry - 1, entry)) {
+            track = track == NULL ? timeline->tracks : track + 1;
+            *track = (Timeline_Track) {
+                .value = entry->value,
+                .components = entry->components,
+                .keys = key,
+            };
+            memcpy(key->from, entry->value, sizeof(float)*entry->components);
+            key->ends_last = 0;
+        } else {
+            size_t count = track->keys_count;
+            timeline_key_eval(timeline_winner(track->keys, count, key->start), track->components, key->start, key->from);
+            size_t last = track->keys[count - 1].ends_last;
+            key->ends_last = key->end >= track->keys[last].end ? count : last;
+        }
+        track->keys_count += 1;
+    }
+
+    if (timeline->tracks_count > 0) qsort(timeline->tracks, timeline->tracks_count, sizeof(*timeline->tracks), timeline_track_compare);
+
+    arena_free(&scratch);
+    return true;
+}
+
+void timeline_eval(const Timeline *timeline, float t)
+{
+    for (size_t i = 0; i < timeline->tracks_count; ++i) {
+        const Timeline_Track *track = &timeline->tracks[i];
+
+        // The first key that starts after t
+        size_t lo = 0;
+        size_t hi = track->keys_count;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo)/2;
+            if (track->keys[mid].start <= t) lo = mid + 1;
+            else hi = mid;
+        }
+
+        if (lo == 0) {
+            memcpy(track->value, track->keys[0].from, sizeof(float)*track->components);
+        } else {
+            timeline_key_eval(timeline_winner(track->keys, lo, t), track->components, t, track->value);
+        }
+    }
+}
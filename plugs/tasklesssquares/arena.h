@@ -23,6 +23,7 @@
 #define ARENA_H_
 
 #include <stddef.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 
@@ -63,10 +64,11 @@ typedef struct {
 Region *new_region(size_t capacity);
 void free_region(Region *r);
 
-// TODO: snapshot/rewind capability for the arena
-// - Snapshot should be combination of a->end and a->end->count.
-// - Rewinding should be restoring a->end and a->end->count from the snapshot and
-// setting count-s of all the Region-s after the remembered a->end to 0.
+typedef struct {
+    Region *region;
+    size_t count;
+} Arena_Mark;
+
 void *arena_alloc(Arena *a, size_t size_bytes);
 void *arena_realloc(Arena *a, void *oldptr, size_t oldsz, size_t newsz);
 char *arena_strdup(Arena *a, const char *cstr);
@@ -75,9 +77,20 @@ void *arena_memdup(Arena *a, void *data, size_t size);
 char *arena_sprintf(Arena *a, const char *format, ...);
 #endif // ARENA_NOSTDIO
 
+// Remembers how much of the arena is allocated, so everything allocated after
+// that can be dropped with arena_rewind() while the regions stay around
+Arena_Mark arena_snapshot(Arena *a);
 void arena_reset(Arena *a);
+void arena_rewind(Arena *a, Arena_Mark m);
 void arena_free(Arena *a);
 
+// Copies everything allocated in the arena into the buffer if it fits and
+// returns how many bytes that takes. arena_load() copies it back into the same
+// regions, so the pointers into the arena stay valid. That only works as long
+// as the arena is reset or rewound in between, but not freed.
+size_t arena_save(Arena *a, void *buffer, size_t size);
+bool arena_load(Arena *a, const void *buffer, size_t size);
+
 #define ARENA_DA_INIT_CAP 256
 
 #ifdef __cplusplus
@@ -278,6 +291,20 @@ char *arena_sprintf(Arena *a, const char *format, ...)
 }
 #endif // ARENA_NOSTDIO
 
+Arena_Mark arena_snapshot(Arena *a)
+{
+    Arena_Mark m;
+    if (a->end == NULL) {
+        ARENA_ASSERT(a->begin == NULL);
+        m.region = NULL;
+        m.count = 0;
+    } else {
+        m.region = a->end;
+        m.count = a->end->count;
+    }
+    return m;
+}
+
 void arena_reset(Arena *a)
 {
     for (Region *r = a->begin; r != NULL; r = r->next) {
@@ -287,6 +314,64 @@ void arena_reset(Arena *a)
     a->end = a->begin;
 }
 
+void arena_rewind(Arena *a, Arena_Mark m)
+{
+    if (m.region == NULL) {
+        arena_reset(a);
+        return;
+    }
+
+    m.region->count = m.count;
+    for (Region *r = m.region->next; r != NULL; r = r->next) {
+        r->count = 0;
+    }
+
+    a->end = m.region;
+}
+
+// Every region up to a->end is saved as its count followed by that many words
+size_t arena_save(Arena *a, void *buffer, size_t size)
+{
+    size_t needed = 0;
+    for (Region *r = a->begin; r != NULL; r = r->next) {
+        needed += sizeof(r->count) + sizeof(*r->data)*r->count;
+        if (r == a->end) break;
+    }
+    if (buffer == NULL || size < needed) return needed;
+
+    char *out = (char*)buffer;
+    for (Region *r = a->begin; r != NULL; r = r->next) {
+        memcpy(out, &r->count, sizeof(r->count));
+        out += sizeof(r->count);
+        memcpy(out, r->data, sizeof(*r->data)*r->count);
+        out += sizeof(*r->data)*r->count;
+        if (r == a->end) break;
+    }
+    return needed;
+}
+
+bool arena_load(Arena *a, const void *buffer, size_t size)
+{
+    const char *in = (const char*)buffer;
+    const char *end = in + size;
+    Region *last = NULL;
+    for (Region *r = a->begin; in < end; r = r->next) {
+        size_t count;
+        if (r == NULL || (size_t)(end - in) < sizeof(count)) return false;
+        memcpy(&count, in, sizeof(count));
+        in += sizeof(count);
+        if (count > r->capacity || (size_t)(end - in) < sizeof(*r->data)*count) return false;
+        memcpy(r->data, in, sizeof(*r->data)*count);
+        in += sizeof(*r->data)*count;
+        r->count = count;
+        last = r;
+    }
+
+    Arena_Mark m = {.region = last, .count = last != NULL ? last->count : 0};
+    arena_rewind(a, m);
+    return true;
+}
+
 void arena_free(Arena *a)
 {
     Region *r = a->begin;
@@ -163,6 +163,7 @@ void plug_update(Env env)
     p->anim.globEnd = 0;
     p->anim.deltaTime = env.delta_time;
     p->finished = loading(p, env);
+    if (env.simulating) return;
 
     ClearBackground(BACKGROUND_COLOR);
 
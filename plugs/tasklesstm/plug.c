@@ -209,7 +209,7 @@ static void task_write_cell(AnimState *anim, Cell *cell, Symbol write, Env env)
     float t1 = prevClipTime(anim, HEAD_WRITING_DURATION);
 
     if (t1 < 0.5 && t >= 0.5) {
-        env.play_sound(p->write_sound, p->write_wave);
+        env.play_sound(p->write_sound, p->write_wave, env_crossing_offset(t1, t, 0.5f));
     }
 
     if (cell) cell->t = smoothstep(t);
@@ -239,7 +239,7 @@ static void task_write_head(AnimState *anim, Symbol write, float duration, Env e
     float t1 = prevClipTime(anim, HEAD_WRITING_DURATION);
 
     if (t1 < 0.5 && t >= 0.5) {
-        env.play_sound(p->write_sound, p->write_wave);
+        env.play_sound(p->write_sound, p->write_wave, env_crossing_offset(t1, t, 0.5f));
     }
 
     if (cell) cell->t = smoothstep(t);
@@ -268,7 +268,7 @@ static void task_write_all(AnimState *anim, Symbol write, Env env)
     float t1 = prevClipTime(anim, HEAD_WRITING_DURATION);
 
     if (t1 < 0.5 && t >= 0.5) {
-        env.play_sound(p->write_sound, p->write_wave);
+        env.play_sound(p->write_sound, p->write_wave, env_crossing_offset(t1, t, 0.5f));
     }
 
     for (size_t i = 0; i < p->scene.tape.count; ++i) {
@@ -705,8 +705,6 @@ static void render_table_lines(float x, float y, float field_width, float field_
 
 void plug_update(Env env)
 {
-    ClearBackground(BACKGROUND_COLOR);
-
     p->anim.clipStartTime = 0;
     p->anim.globEnd = 0;
     p->anim.currentTime += env.delta_time;
@@ -715,6 +713,9 @@ void plug_update(Env env)
     
         
     p->scene.finished = p->anim.currentTime >= p->anim.clipStartTime;
+    if (env.simulating) return;
+
+    ClearBackground(BACKGROUND_COLOR);
 
 /*
     for (size_t i = 0; i < p->scene.table.count; ++i) {
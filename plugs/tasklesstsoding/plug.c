@@ -65,6 +65,17 @@ void co_sleep(AnimState *anim, float duration)
     anim_wait(anim, duration) ;
 }
 
+// Plays the kick if the current clip started during this frame
+static void kick(AnimState *anim)
+{
+    float curr = clipTime(anim, 0.1f);
+    float prev = prevClipTime(anim, 0.1f);
+    if(curr > 0 && prev == 0.0) {
+        float offset = env_crossing_offset(anim->currentTime - anim->deltaTime, anim->currentTime, anim->clipStartTime);
+        p->env.play_sound(p->kick_sound, p->kick_wave, offset);
+    }
+}
+
 void animation(AnimState *anim, void *data)
 {
     UNUSED(data);
@@ -76,26 +87,20 @@ void animation(AnimState *anim, void *data)
 
     float duration = 0.15f;
     float sleep = 0.25f;
-    float curr = clipTime(anim, 0.1f);
-    float prev = prevClipTime(anim, 0.1f);
-    if(curr > 0 && prev == 0.0)
-        p->env.play_sound(p->kick_sound, p->kick_wave);
+    kick(anim);
     co_interpolate(anim, &p->radius, 0.f, 1.f, duration);
     co_sleep(anim, sleep);
-    if(clipTime(anim, 0.1f) > 0 && prevClipTime(anim, 0.1f) == 0.0)
-        p->env.play_sound(p->kick_sound, p->kick_wave);
+    kick(anim);
     co_interpolate(anim, &p->roundness, 0.f, 1.f, duration);
     co_sleep(anim, sleep);
-    if(clipTime(anim, 0.1f) > 0 && prevClipTime(anim, 0.1f) == 0.0)
-        p->env.play_sound(p->kick_sound, p->kick_wave);
+    kick(anim);
     co_interpolate3(anim,
          &p->alpha,     0.f, 1.f,
          &p->roundness, 1.f, 0.f,
          &p->rotation,  0.f, 1.f,
          duration);
     co_sleep(anim, sleep);
-    if(clipTime(anim, 0.1f) > 0 && prevClipTime(anim, 0.1f) == 0.0)
-        p->env.play_sound(p->kick_sound, p->kick_wave);
+    kick(anim);
     co_interpolate(anim, &p->radius, 1.f, 0.f, duration);
     co_sleep(anim, 2.0);
 }
@@ -150,6 +155,7 @@ void plug_update(Env env)
     animation(&p->anim, NULL);
 
     p->finished = p->anim.currentTime >= p->anim.clipStartTime;
+    if (env.simulating) return;
 
     Color background_color = GetColor(0x181818FF);
     Color green_color      = GetColor(0x73C936FF);
@@ -65,6 +65,8 @@ void plug_post_reload(void *state)
 
 void plug_update(Env env)
 {
+    if (env.simulating) return;
+
     Color background_color = ColorFromHSV(0, 0, 0.05);
     Color foreground_color = ColorFromHSV(0, 0, 0.95);
 
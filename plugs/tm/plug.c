@@ -14,6 +14,7 @@
 
 #define PLUG(name, ret, ...) ret name(__VA_ARGS__);
 LIST_OF_PLUGS
+LIST_OF_OPTIONAL_PLUGS
 #undef PLUG
 
 #if 0
@@ -150,6 +151,7 @@ typedef struct {
         Tape tape;
         Table table;
         float tape_y_offset;
+        Task_Pools task_pools;
         Task task;
         bool finished;
     } scene;
@@ -257,7 +259,7 @@ static bool write_cell_update(Write_Cell_Data *data, Env env)
     float t2 = wait_interp(&data->wait);
 
     if (t1 < 0.5 && t2 >= 0.5) {
-        env.play_sound(p->write_sound, p->write_wave);
+        env.play_sound(p->write_sound, p->write_wave, env_crossing_offset(t1, t2, 0.5f));
     }
 
     if (data->cell) data->cell->t = smoothstep(t2);
@@ -312,7 +314,7 @@ static bool write_head_update(Write_Head_Data *data, Env env)
     float t2 = wait_interp(&data->wait);
 
     if (t1 < 0.5 && t2 >= 0.5) {
-        env.play_sound(p->write_sound, p->write_wave);
+        env.play_sound(p->write_sound, p->write_wave, env_crossing_offset(t1, t2, 0.5f));
     }
 
     if (cell) cell->t = smoothstep(t2);
@@ -363,7 +365,7 @@ static bool write_all_update(Write_All_Data *data, Env env)
     float t2 = wait_interp(&data->wait);
 
     if (t1 < 0.5 && t2 >= 0.5) {
-        env.play_sound(p->write_sound, p->write_wave);
+        env.play_sound(p->write_sound, p->write_wave, env_crossing_offset(t1, t2, 0.5f));
     }
 
     for (size_t i = 0; i < p->scene.tape.count; ++i) {
@@ -467,6 +469,7 @@ static void load_assets(void)
     p->write_sound = LoadSoundFromWave(p->write_wave);
 
     task_vtable_rebuild(a);
+    task_pools = &p->scene.task_pools;
     p->TASK_INTRO_TAG = task_vtable_register(a, (Task_Funcs) {
         .update = (task_update_data_t)task_intro_update,
     });
@@ -598,6 +601,13 @@ static Task task_inc(Arena *a, Symbol zero, Symbol one)
         task_wait(a, delay));
 }
 
+static size_t arena_used(Arena *a)
+{
+    size_t bytes = 0;
+    for (Region *r = a->begin; r != NULL; r = r->next) bytes += r->count*sizeof(uintptr_t);
+    return bytes;
+}
+
 void plug_reset(void)
 {
     Arena *a = &p->arena_state;
@@ -669,6 +679,11 @@ void plug_init(void)
 
     load_assets();
     plug_reset();
+
+    // Only once, the preview resets the animation every time it jumps
+    size_t tasks = task_count(p->scene.task);
+    size_t bytes = arena_used(&p->arena_state);
+    TraceLog(LOG_INFO, "TM: %zu tasks, %zu bytes of state arena (%.1f bytes per task)", tasks, bytes, (float)bytes/tasks);
 }
 
 void *plug_pre_reload(void)
@@ -781,8 +796,6 @@ static void render_table_lines(float x, float y, float field_width, float field_
 
 void plug_update(Env env)
 {
-    ClearBackground(BACKGROUND_COLOR);
-
     p->scene.finished = task_update(p->scene.task, env);
 
     for (size_t i = 0; i < p->scene.table.count; ++i) {
@@ -800,6 +813,10 @@ void plug_update(Env env)
         }
     }
 
+    if (env.simulating) return;
+
+    ClearBackground(BACKGROUND_COLOR);
+
     float head_thick = 20.0;
     float head_padding = head_thick*2.5;
     Rectangle head_rec = {
@@ -941,6 +958,52 @@ bool plug_finished(void)
     return p->scene.finished;
 }
 
+// The state is the scene, the cells of the tape and everything allocated in
+// arena_state. arena_load() puts the arena back into the same regions, so the
+// pointers saved along with the scene stay valid. The tape is not in the arena
+// and keeps whatever it is allocated in at the moment.
+size_t plug_save(void *buffer, size_t size)
+{
+    size_t tape_size = sizeof(*p->scene.tape.items)*p->scene.tape.count;
+    size_t arena_size = arena_save(&p->arena_state, NULL, 0);
+    size_t needed = sizeof(p->scene) + tape_size + arena_size;
+    if (buffer == NULL || size < needed) return needed;
+
+    char *out = buffer;
+    memcpy(out, &p->scene, sizeof(p->scene));
+    out += sizeof(p->scene);
+    memcpy(out, p->scene.tape.items, tape_size);
+    out += tape_size;
+    arena_save(&p->arena_state, out, arena_size);
+    return needed;
+}
+
+void plug_load(const void *buffer, size_t size)
+{
+    assert(size >= sizeof(p->scene));
+    const char *in = buffer;
+
+    // Nothing is restored before the arena is back, so a saved state that
+    // doesn't fit the arena anymore leaves a clean reset behind
+    Plug saved;
+    memcpy(&saved.scene, in, sizeof(saved.scene));
+    in += sizeof(saved.scene);
+    const Cell *cells = (const Cell*)in;
+    in += sizeof(*cells)*saved.scene.tape.count;
+
+    if (!arena_load(&p->arena_state, in, size - (in - (const char*)buffer))) {
+        TraceLog(LOG_ERROR, "TM: the state arena does not match the saved state anymore");
+        plug_reset();
+        return;
+    }
+
+    Tape tape = p->scene.tape;
+    p->scene = saved.scene;
+    p->scene.tape = tape;
+    p->scene.tape.count = 0;
+    nob_da_append_many(&p->scene.tape, cells, saved.scene.tape.count);
+}
+
 #define ARENA_IMPLEMENTATION
 #include "arena.h"
 #include "tasks.c"
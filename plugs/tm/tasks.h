@@ -1,6 +1,8 @@
 #ifndef TASKS_H_
 #define TASKS_H_
 
+#include <stdint.h>
+
 #include "env.h"
 #include "arena.h"
 #include "interpolators.h"
@@ -13,12 +15,28 @@ typedef struct {
 } Task;
 
 typedef bool (*task_update_data_t)(void*, Env);
+// Puts the task into its state t seconds after it started and returns how
+// long it takes. For t < 0 it goes back to before it started, undoing what it
+// changed. task_seek() always does that to the whole tree first, so for
+// t >= 0 the task can count on starting from there. It may be seeked forward
+// more than once after that.
+typedef float (*task_seek_data_t)(void*, float);
 
 typedef struct {
     task_update_data_t update;
+    // Optional, only the trees where every task has it can be seeked
+    task_seek_data_t seek;
 } Task_Funcs;
 
 bool task_update(Task task, Env env);
+// Puts the tree and the values it moves into the state they would be in
+// after playing for t seconds from the start, wherever the tree is now. What
+// it costs depends on the size of the tree, not on how far t is. The other
+// trees that are running keep going from where they are. Of the moves that
+// overlap on the same value the last one in the tree wins, which is not
+// always the one the runtime would pick, timeline_eval() gets that right.
+// Returns false without touching anything if a task of the tree can't seek.
+bool task_seek(Task task, float t);
 
 typedef struct {
     Task_Funcs *items;
@@ -55,41 +73,86 @@ bool wait_update(Wait_Data *data, Env env);
 Wait_Data wait_data(float duration);
 Task task_wait(Arena *a, float duration);
 
+// The tasks of the built-in kinds don't carry their data around. Each kind
+// keeps it in its own structure-of-arrays pool and Task.data is only the
+// index of the task in that pool plus one. The moves that are running are
+// packed at the front of the arrays of their pool, and the walk over the tree
+// of tasks merely marks them as visited. Their timers, easing and values are
+// then updated in one batch per kind once the outermost task_update() returns.
+
 typedef struct {
-    Wait_Data wait;
-    float *value;
-    float start, target;
-    Interp_Func func;
-} Move_Scalar_Data;
+    float *cursor;
+    float *duration;
+    size_t count;
+    size_t capacity;
+} Wait_Pool;
 
-bool move_scalar_update(Move_Scalar_Data *data, Env env);
-Move_Scalar_Data move_scalar_data(float *value, float target, float duration, Interp_Func func);
-Task task_move_scalar(Arena *a, float *value, float target, float duration, Interp_Func);
+typedef enum {
+    MOVE_IDLE = 0,
+    MOVE_RUNNING,
+    MOVE_DONE,
+} Move_State;
 
 typedef struct {
-    Wait_Data wait;
-    Vector2 *value;
-    Vector2 start, target;
-    Interp_Func func;
-} Move_Vec2_Data;
+    // How many floats the moved value consists of, e.g. 2 for Vector2
+    size_t components;
+
+    // Every move of the pool, indexed by Task.data - 1
+    float **value;
+    float *target;
+    float *duration;
+    Interp_Func *func;
+    uint8_t *state;
+    uint32_t *slot;
+    // What the value was when the move started, so task_seek() can put it back
+    bool *started;
+    float *from;
+    size_t count;
+    size_t capacity;
+
+    // The moves that are running, indexed by their slot. start and target
+    // have a plane of capacity floats for each component.
+    struct {
+        uint32_t *move;
+        float **value;
+        float *cursor;
+        float *duration;
+        Interp_Func *func;
+        bool *visited;
+        float *start;
+        float *target;
+        // The slots that finish in this frame, filled by the flush
+        uint32_t *finished;
+        size_t count;
+    } running;
+} Move_Pool;
 
-bool move_vec2_update(Move_Vec2_Data *data, Env env);
-Move_Vec2_Data move_vec2_data(Vector2 *value, Vector2 target, float duration, Interp_Func func);
+Task task_move_scalar(Arena *a, float *value, float target, float duration, Interp_Func);
 Task task_move_vec2(Arena *a, Vector2 *value, Vector2 target, float duration, Interp_Func func);
+Task task_move_vec4(Arena *a, Vector4 *value, Vector4 target, float duration, Interp_Func func);
 
+// Belongs to the state of the plugin, next to the arena the tasks are
+// allocated from. It has to be zeroed whenever that arena is reset, and
+// task_pools has to point at it again after every reload, just like
+// task_vtable_rebuild() has to be called.
 typedef struct {
-    Wait_Data wait;
-    Vector4 *value;
-    Vector4 start, target;
-    Interp_Func func;
-} Move_Vec4_Data;
+    Wait_Pool wait;
+    Move_Pool move_scalar;
+    Move_Pool move_vec2;
+    Move_Pool move_vec4;
+} Task_Pools;
 
-bool move_vec4_update(Move_Vec4_Data *data, Env env);
-Move_Vec4_Data move_vec4_data(Vector4 *value, Vector4 target, float duration, Interp_Func func);
-Task task_move_vec4(Arena *a, Vector4 *value, Vector4 target, float duration, Interp_Func func);
+extern Task_Pools *task_pools;
 
 typedef struct {
     Tasks tasks;
+    // The indices of the children that have not finished yet, in the order
+    // of tasks. Only those are updated, so the children that are done cost
+    // nothing however long the group keeps running.
+    uint32_t *active;
+    size_t active_count;
+    // Worked out by task_seek()
+    float duration;
 } Group_Data;
 
 bool group_update(Group_Data *data, Env env);
@@ -99,10 +162,61 @@ Task task_group_(Arena *a, ...);
 typedef struct {
     Tasks tasks;
     size_t it;
+    // Worked out by task_seek()
+    float duration;
 } Seq_Data;
 
 bool seq_update(Seq_Data *data, Env env);
 Task task_seq_(Arena *a, ...);
 #define task_seq(...) task_seq_(__VA_ARGS__, (Task){0})
 
+// How many tasks the tree consists of, including the groups and sequences
+size_t task_count(Task task);
+
+// A tree of waits, moves, groups and sequences flattened into absolute time.
+// Every value that the tree moves gets a track with its keys sorted by start,
+// so the state at any time is found without replaying every frame before it.
+// A binary search finds the keys of a track that started by then, and a walk
+// back over the ones that already ended finds the one still running. That walk
+// is short unless many moves of the same value overlap a long one, at worst it
+// goes over the whole track.
+
+typedef struct {
+    float start;
+    float end;
+    Interp_Func func;
+    // What the value is at start. The runtime only finds that out once the
+    // move begins, the compiler works it out from the keys before.
+    float from[4];
+    float to[4];
+    // Index of the key of the track that ends last out of this key and the
+    // ones before it
+    size_t ends_last;
+} Timeline_Key;
+
+typedef struct {
+    float *value;
+    size_t components;
+    Timeline_Key *keys;
+    size_t keys_count;
+} Timeline_Track;
+
+typedef struct {
+    // Sorted by the start of their first key
+    Timeline_Track *tracks;
+    size_t tracks_count;
+    Timeline_Key *keys;
+    size_t keys_count;
+    float duration;
+} Timeline;
+
+// Has to be called on a tree that was not updated yet, because the values it
+// moves are read to find out where the first keys start from. Fails on tasks
+// of kinds other than the built-in ones.
+bool timeline_compile(Arena *a, Task task, Timeline *timeline);
+// Puts every value of the timeline into its state at time t. Of the moves
+// that overlap on the same value the one that started last wins while it
+// runs, just like in the runtime.
+void timeline_eval(const Timeline *timeline, float t);
+
 #endif // TASKS_H_
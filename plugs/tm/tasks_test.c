@@ -0,0 +1,253 @@
+// Checks the task runtime against the other ways of getting to the same state.
+// Built and run by `./nob test`.
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <raylib.h>
+#include <raymath.h>
+
+#include "env.h"
+#include "interpolators.h"
+#include "tasks.h"
+
+// Every duration is a multiple of the frame time. The runtime spends at least
+// one frame on every child of a sequence, so otherwise it drifts away from the
+// exact times the timeline works with.
+#define TEST_DT (1.0f/64)
+#define TEST_MAX_FRAMES 1024
+#define TEST_EPSILON 1e-4f
+// One value of each kind per Interp_Func
+#define VALUES_COUNT (FUNC_SINPULSE + 1)
+
+static Task_Pools pools = {0};
+static float scalars[VALUES_COUNT];
+static Vector2 vec2s[VALUES_COUNT];
+static Vector4 vec4s[VALUES_COUNT];
+
+#define STATE_SIZE (VALUES_COUNT*(1 + 2 + 4))
+static float states[TEST_MAX_FRAMES][STATE_SIZE];
+
+static void values_reset(void)
+{
+    for (size_t i = 0; i < VALUES_COUNT; ++i) {
+        scalars[i] = (float)i;
+        vec2s[i] = (Vector2) {(float)i, -(float)i};
+        vec4s[i] = (Vector4) {(float)i, 1, 2, 3};
+    }
+}
+
+static void values_save(float *state)
+{
+    memcpy(state, scalars, sizeof(scalars));
+    memcpy(state + VALUES_COUNT, vec2s, sizeof(vec2s));
+    memcpy(state + VALUES_COUNT*3, vec4s, sizeof(vec4s));
+}
+
+static bool floats_check(const char *name, size_t frame, const float *state, const float *expected, size_t first, size_t count)
+{
+    for (size_t j = first; j < first + count; ++j) {
+        if (fabsf(state[j] - expected[j]) > TEST_EPSILON) {
+            fprintf(stderr, "%s: frame %zu: float %zu is %f instead of %f\n", name, frame, j, state[j], expected[j]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Only checks the values from first to first + count of each kind
+static bool values_check_some(const char *name, size_t frame, const float *expected, size_t first, size_t count)
+{
+    float state[STATE_SIZE];
+    values_save(state);
+    return floats_check(name, frame, state, expected, first, count)
+        && floats_check(name, frame, state, expected, VALUES_COUNT + first*2, count*2)
+        && floats_check(name, frame, state, expected, VALUES_COUNT*3 + first*4, count*4);
+}
+
+static bool values_check(const char *name, size_t frame, const float *expected)
+{
+    return values_check_some(name, frame, expected, 0, VALUES_COUNT);
+}
+
+// Starts every test from fresh pools and values, just like a plugin reset
+static void tasks_reset(Arena *a)
+{
+    arena_reset(a);
+    task_vtable_rebuild(a);
+    memset(&pools, 0, sizeof(pools));
+    task_pools = &pools;
+    values_reset();
+}
+
+// Moves that overlap on the same value in all the ways they can
+static Task overlaps(Arena *a, size_t i)
+{
+    Interp_Func func = (Interp_Func)i;
+    Interp_Func other = (Interp_Func)((i + 2)%VALUES_COUNT);
+    float d = (float)(4 + i)*TEST_DT;
+    return task_group(a,
+        // A shorter move takes over a long one for a while
+        task_move_scalar(a, &scalars[i], 10.0f + i, 8*d, func),
+        task_seq(a, task_wait(a, 2*d), task_move_scalar(a, &scalars[i], -3.0f, d, other)),
+
+        // Two moves start together
+        task_move_vec2(a, &vec2s[i], (Vector2) {1, 2}, d, func),
+        task_move_vec2(a, &vec2s[i], (Vector2) {5, -4}, 2*d, other),
+
+        // A move starts in the middle of another one and outlives it
+        task_move_vec4(a, &vec4s[i], (Vector4) {1, 2, 3, 4}, 2*d, func),
+        task_seq(a,
+            task_wait(a, d),
+            task_move_vec4(a, &vec4s[i], (Vector4) {-1, 0, 1, 0}, 3*d, other),
+            task_move_vec4(a, &vec4s[i], (Vector4) {7, 7, 7, 7}, d, func)));
+}
+
+static Task overlaps_all(Arena *a)
+{
+    return task_group(a,
+        overlaps(a, 0), overlaps(a, 1), overlaps(a, 2),
+        overlaps(a, 3), overlaps(a, 4), overlaps(a, 5));
+}
+
+// Moves one after the other on each value, with waits and moves of other
+// values in between
+static Task sequences(Arena *a, size_t i)
+{
+    Interp_Func func = (Interp_Func)i;
+    Interp_Func other = (Interp_Func)((i + 3)%VALUES_COUNT);
+    float d = (float)(3 + i)*TEST_DT;
+    return task_group(a,
+        task_seq(a,
+            task_move_scalar(a, &scalars[i], 10.0f + i, 4*d, func),
+            task_wait(a, d),
+            task_move_scalar(a, &scalars[i], -3.0f, 2*d, other)),
+        task_seq(a,
+            task_wait(a, 2*d),
+            task_move_vec2(a, &vec2s[i], (Vector2) {1, 2}, 3*d, func),
+            task_move_vec2(a, &vec2s[i], (Vector2) {5, -4}, d, other)),
+        task_move_vec4(a, &vec4s[i], (Vector4) {1, 2, 3, 4}, 6*d, other));
+}
+
+// Half of the values, so two trees can run side by side
+#define HALF_COUNT (VALUES_COUNT/2)
+
+static Task sequences_half(Arena *a, size_t first)
+{
+    return task_group(a, sequences(a, first), sequences(a, first + 1), sequences(a, first + 2));
+}
+
+// Records the state of the values after every frame of the runtime
+static size_t run(Task task)
+{
+    Env env = {.delta_time = TEST_DT};
+    for (size_t frame = 0; frame < TEST_MAX_FRAMES; ++frame) {
+        bool finished = task_update(task, env);
+        values_save(states[frame]);
+        if (finished) return frame + 1;
+    }
+    return TEST_MAX_FRAMES;
+}
+
+static bool test_timeline(Arena *a)
+{
+    tasks_reset(a);
+    size_t frames = run(overlaps_all(a));
+
+    tasks_reset(a);
+    Timeline timeline = {0};
+    if (!timeline_compile(a, overlaps_all(a), &timeline)) {
+        fprintf(stderr, "timeline: could not compile the tasks\n");
+        return false;
+    }
+    if (fabsf(timeline.duration - frames*TEST_DT) > TEST_EPSILON) {
+        fprintf(stderr, "timeline: lasts %f instead of %f\n", timeline.duration, frames*TEST_DT);
+        return false;
+    }
+
+    // Backwards, so nothing depends on the frames being evaluated in order
+    for (size_t frame = frames; frame-- > 0;) {
+        timeline_eval(&timeline, (frame + 1)*TEST_DT);
+        if (!values_check("timeline", frame, states[frame])) return false;
+    }
+    return true;
+}
+
+// Runs two trees side by side, seeks the first one somewhere else in the
+// middle and checks that only the first one jumps while the second one goes
+// on as if nothing happened
+static bool test_seek(Arena *a)
+{
+    tasks_reset(a);
+    Task first = sequences_half(a, 0);
+    Task second = sequences_half(a, HALF_COUNT);
+    Env env = {.delta_time = TEST_DT};
+    size_t frames = 0;
+    for (bool finished = false; !finished && frames < TEST_MAX_FRAMES; ++frames) {
+        finished = task_update(first, env);
+        finished = task_update(second, env) && finished;
+        values_save(states[frames]);
+    }
+
+    // Where the second tree is when the first one is seeked, and where the
+    // first one is seeked to. Forward, back and to the same frame.
+    size_t seeks[][2] = {
+        {frames/3, frames/2},
+        {frames/2, 2},
+        {frames/2, frames/2},
+        {5, frames - 1},
+    };
+    for (size_t i = 0; i < sizeof(seeks)/sizeof(seeks[0]); ++i) {
+        size_t at = seeks[i][0];
+        size_t to = seeks[i][1];
+
+        tasks_reset(a);
+        first = sequences_half(a, 0);
+        second = sequences_half(a, HALF_COUNT);
+        for (size_t frame = 0; frame <= at; ++frame) {
+            task_update(first, env);
+            task_update(second, env);
+        }
+
+        if (!task_seek(first, (to + 1)*TEST_DT)) {
+            fprintf(stderr, "seek: could not seek the tasks\n");
+            return false;
+        }
+        for (size_t frame = 0; at + frame < frames && to + frame < frames; ++frame) {
+            if (frame > 0) {
+                task_update(first, env);
+                task_update(second, env);
+            }
+            if (!values_check_some("seek (first tree)", to + frame, states[to + frame], 0, HALF_COUNT)) return false;
+            if (!values_check_some("seek (second tree)", at + frame, states[at + frame], HALF_COUNT, HALF_COUNT)) return false;
+        }
+    }
+    return true;
+}
+
+typedef struct {
+    const char *name;
+    bool (*run)(Arena *a);
+} Test;
+
+static const Test tests[] = {
+    {.name = "timeline", .run = test_timeline},
+    {.name = "seek",     .run = test_seek},
+};
+
+int main(void)
+{
+    Arena a = {0};
+    int result = 0;
+    for (size_t i = 0; i < sizeof(tests)/sizeof(tests[0]); ++i) {
+        bool ok = tests[i].run(&a);
+        printf("%s: %s\n", tests[i].name, ok ? "OK" : "FAILED");
+        if (!ok) result = 1;
+    }
+    arena_free(&a);
+    return result;
+}
+
+#define ARENA_IMPLEMENTATION
+#include "arena.h"
+#include "tasks.c"